@@ -0,0 +1,338 @@
+#include "../compile.h"
+#include "../trace.h"
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+/**
+ * runs the programs in bench/ with each engine and prints one JSON object per line for every case and engine.
+ *
+ * built like the interpreter, with bench/bench.cpp in place of main.cpp, and run from the repository root:
+ *
+ *     bench [--engine=NAME]... [--repeat=N] [--corpus=DIR] [--scale=MB] [CASE]...
+ *
+ * every engine is run unless some are given. a case is a .lc file in the corpus directory, loaded on top of
+ * prelude.lc, which is loaded once. the tokenize case tokenizes the text of the other cases, repeated up to
+ * `scale` megabytes, both from a stream and from a memory-mapped file
+ **/
+
+using namespace lambda;
+
+/**
+ * allocations counted by the replaced operator new, for every thread. `peak` is the most allocations live at
+ * once, and is reset before each measurement
+ **/
+static std::atomic<long> allocations(0);
+static std::atomic<long> live(0);
+static std::atomic<long> peak(0);
+
+void * operator new(std::size_t size) {
+    void * p = std::malloc(size != 0 ? size : 1);
+    if(p == nullptr)
+        throw std::bad_alloc();
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    long now = live.fetch_add(1, std::memory_order_relaxed) + 1;
+    long seen = peak.load(std::memory_order_relaxed);
+    while(now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed));
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    if(p == nullptr)
+        return;
+    live.fetch_sub(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+/**
+ * adds up what load_file reports about a case. steps are only asked for on the run that measures the largest
+ * term, since looking at every step slows the rewrite engine down
+ **/
+class bench_trace : public trace_sink {
+public:
+    bool steps_wanted = false;
+    long statements = 0;
+    long steps = 0;
+    long beta = 0;
+    long delta = 0;
+    long timeouts = 0;
+    long renames = 0;
+    long nodes = 0;
+    long copied_bytes = 0;
+    /**most components live at once during a statement, beyond those live when it started**/
+    long peak_nodes = 0;
+    /**nodes in the largest term seen: a statement, a step of the rewrite engine, or a result**/
+    size_t peak_term = 0;
+
+    void statement(const component& term, int, const std::string&) override {
+        peak_term = std::max(peak_term, term.size());
+    }
+    bool wants_steps() const override { return steps_wanted; }
+    void step(const component& term) override {
+        peak_term = std::max(peak_term, term.size());
+    }
+    void result(const component& term, int taken, const reduction_stats * stats, double) override {
+        ++statements;
+        steps += taken;
+        //engines that count their own work do it on their own terms rather than on components
+        if(stats != nullptr) {
+            beta += stats->beta;
+            delta += stats->delta;
+        } else {
+            beta += done.beta;
+            delta += done.delta;
+        }
+        peak_term = std::max(peak_term, term.size());
+    }
+    void work(const work_counters& done) override {
+        this->done = done;
+        renames += done.renames;
+        nodes += done.allocated;
+        copied_bytes += done.copied_bytes;
+        peak_nodes = std::max(peak_nodes, done.peak);
+    }
+    void timeout(int, const std::string&) override {
+        ++timeouts;
+    }
+private:
+    work_counters done;
+};
+
+/**what running a case some number of times gave. counts are from the first run**/
+struct measurement {
+    double best_ms = -1;
+    double total_ms = 0;
+    long allocations = 0;
+    long peak_live = 0;
+    bench_trace counts;
+};
+
+static std::string json_string(const std::string& s) {
+    std::string ret = "\"";
+    for(char c : s) {
+        if(c == '"' || c == '\\')
+            ret += '\\';
+        ret += c;
+    }
+    return ret + "\"";
+}
+
+static const char * engine_name(engine with) {
+    switch(with) {
+    case engine::rewrite: return "rewrite";
+    case engine::graph: return "graph";
+    case engine::krivine: return "krivine";
+    case engine::nbe: return "nbe";
+    case engine::bytecode: return "bytecode";
+    case engine::parallel: return "parallel";
+    }
+    return "unknown";
+}
+
+static bool read_file(const std::string& filename, std::string& out) {
+    std::ifstream ifs(filename, std::ifstream::binary);
+    if(!ifs.is_open())
+        return false;
+    std::ostringstream text;
+    text << ifs.rdbuf();
+    out = text.str();
+    return true;
+}
+
+/**starts counting allocations from here, returning the count so far**/
+static long start_counting() {
+    peak.store(live.load());
+    return allocations.load();
+}
+
+static measurement run_case(const std::string& filename, std::shared_ptr<global_package> prelude, engine with,
+        int repeat) {
+    measurement ret;
+    load_options opts;
+    opts.with = with;
+    for(int i = 0; i < repeat; ++i) {
+        global_package ctx(prelude);
+        bench_trace counts;
+        opts.tuning.trace = &counts;
+        long base = live.load();
+        long allocated = start_counting();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        load_file(filename, ctx, opts);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if(i == 0) {
+            ret.allocations = allocations.load() - allocated;
+            ret.peak_live = peak.load() - base;
+            ret.counts = counts;
+        }
+        ret.total_ms += elapsed.count();
+        if(ret.best_ms < 0 || elapsed.count() < ret.best_ms)
+            ret.best_ms = elapsed.count();
+    }
+    //only the rewrite engine reports its steps
+    if(with == engine::rewrite) {
+        global_package ctx(prelude);
+        bench_trace counts;
+        counts.steps_wanted = true;
+        opts.tuning.trace = &counts;
+        load_file(filename, ctx, opts);
+        ret.counts.peak_term = std::max(ret.counts.peak_term, counts.peak_term);
+    }
+    return ret;
+}
+
+static void print_case(const std::string& name, engine with, int repeat, size_t bytes, const measurement& m) {
+    const bench_trace& c = m.counts;
+    std::cout << "{\"case\":" << json_string(name) << ",\"engine\":\"" << engine_name(with) << "\""
+        << ",\"repeat\":" << repeat << ",\"bytes\":" << bytes
+        << ",\"statements\":" << c.statements << ",\"timeouts\":" << c.timeouts
+        << ",\"ms\":" << m.best_ms << ",\"mean_ms\":" << m.total_ms / repeat
+        << ",\"steps\":" << c.steps << ",\"beta\":" << c.beta << ",\"delta\":" << c.delta
+        << ",\"renames\":" << c.renames << ",\"nodes\":" << c.nodes << ",\"copied_bytes\":" << c.copied_bytes
+        << ",\"peak_live_nodes\":" << c.peak_nodes
+        << ",\"allocations\":" << m.allocations << ",\"peak_live_allocations\":" << m.peak_live
+        << ",\"peak_term_nodes\":" << c.peak_term << "}\n";
+}
+
+/**prints the best and mean of `times` and the allocations counted on the first run for a tokenize case**/
+static void print_tokenize(const char * name, size_t bytes, size_t tokens, const std::vector<double>& times,
+        long allocated, long peak_live) {
+    double best = *std::min_element(times.begin(), times.end());
+    double total = 0;
+    for(double t : times)
+        total += t;
+    std::cout << "{\"case\":\"" << name << "\",\"repeat\":" << times.size() << ",\"bytes\":" << bytes
+        << ",\"tokens\":" << tokens << ",\"ms\":" << best << ",\"mean_ms\":" << total / times.size()
+        << ",\"mb_per_s\":" << (best > 0 ? bytes / best / 1000 : 0)
+        << ",\"allocations\":" << allocated << ",\"peak_live_allocations\":" << peak_live << "}\n";
+}
+
+/**
+ * tokenizes `text` `repeat` times from a stream into tokens that own their text (tokenize), then from a
+ * temporary file into tokens that view its mapping (tokenize_mapped), printing the best time of each
+ **/
+static void run_tokenize(const std::string& text, int repeat) {
+    std::vector<double> times;
+    size_t tokens = 0;
+    long allocated = 0, peak_live = 0;
+    for(int i = 0; i < repeat; ++i) {
+        std::istringstream in(text);
+        long base = live.load();
+        long before = start_counting();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<token> tok = tokenize(in, "tokenize");
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if(i == 0) {
+            allocated = allocations.load() - before;
+            peak_live = peak.load() - base;
+            tokens = tok.size();
+        }
+        times.push_back(elapsed.count());
+    }
+    print_tokenize("tokenize", text.size(), tokens, times, allocated, peak_live);
+
+    std::string filename = (std::filesystem::temp_directory_path() / "lc_bench_tokenize.lc").string();
+    {
+        std::ofstream out(filename, std::ofstream::binary);
+        out << text;
+        if(!out) {
+            std::cerr << "could not write '" << filename << "'\n";
+            return;
+        }
+    }
+    times.clear();
+    for(int i = 0; i < repeat; ++i) {
+        long base = live.load();
+        long before = start_counting();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        source_text source;
+        source.map(filename);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if(i == 0) {
+            allocated = allocations.load() - before;
+            peak_live = peak.load() - base;
+            tokens = source.tokens().size();
+        }
+        times.push_back(elapsed.count());
+    }
+    std::remove(filename.c_str());
+    print_tokenize("tokenize_mapped", text.size(), tokens, times, allocated, peak_live);
+}
+
+int main(int argc, char ** argv) {
+    std::vector<engine> engines;
+    std::vector<std::string> cases;
+    std::string corpus = "bench";
+    int repeat = 3;
+    size_t scale = 4;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg.compare(0, 9, "--engine=") == 0) {
+            engine with;
+            if(!engine_from_string(arg.substr(9), with)) {
+                std::cerr << "unknown engine '" << arg.substr(9) << "'\n";
+                return 1;
+            }
+            engines.push_back(with);
+        } else if(arg.compare(0, 9, "--repeat=") == 0) {
+            repeat = std::max(1, std::stoi(arg.substr(9)));
+        } else if(arg.compare(0, 9, "--corpus=") == 0) {
+            corpus = arg.substr(9);
+        } else if(arg.compare(0, 8, "--scale=") == 0) {
+            scale = std::stoul(arg.substr(8));
+        } else {
+            cases.push_back(arg);
+        }
+    }
+    if(engines.empty()) {
+        engines = {engine::rewrite, engine::graph, engine::krivine, engine::nbe, engine::bytecode,
+            engine::parallel};
+    }
+    const std::vector<std::string> corpus_cases = {"parse", "numerals", "recursion", "nesting", "wide"};
+    if(cases.empty()) {
+        cases.push_back("tokenize");
+        cases.insert(cases.end(), corpus_cases.begin(), corpus_cases.end());
+    }
+
+    std::shared_ptr<global_package> prelude = std::make_shared<global_package>();
+    if(!load_file(corpus + "/prelude.lc", *prelude)) {
+        std::cerr << "could not open '" << corpus << "/prelude.lc'\n";
+        return 1;
+    }
+
+    std::string all_text;
+    for(const std::string& name : corpus_cases) {
+        std::string text;
+        if(read_file(corpus + "/" + name + ".lc", text))
+            all_text += text;
+    }
+
+    for(const std::string& name : cases) {
+        if(name == "tokenize") {
+            std::string text;
+            while(!all_text.empty() && text.size() < (scale << 20))
+                text += all_text;
+            run_tokenize(text, repeat);
+            continue;
+        }
+        std::string filename = corpus + "/" + name + ".lc";
+        std::string text;
+        if(!read_file(filename, text)) {
+            std::cerr << "could not open '" << filename << "'\n";
+            return 1;
+        }
+        for(engine with : engines)
+            print_case(name, with, repeat, text.size(), run_case(filename, prelude, with, repeat));
+    }
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "bytecode.h"
+
+namespace lambda {
+
+/**thrown out of the vm once the step budget is used up**/
+struct bytecode_timeout {};
+
+/**readback of shared arguments can be exponential without taking any steps, so it is capped separately**/
+static const size_t max_readback = 1 << 22;
+
+/**readback recurses once per node of the result, so results nested deeper than this are treated as a timeout**/
+static const int max_nesting = 1 << 14;
+
+/**the store is not compacted while it is smaller than this, so small programs never recompile anything**/
+static const size_t min_compact = 1 << 8;
+
+bytecode_vm::bytecode_vm() : defs(true) {
+    compact_at = min_compact;
+    stats = nullptr;
+    budget = 0;
+    nesting = 0;
+}
+
+void bytecode_vm::spend() {
+    if(--budget < 0)
+        throw bytecode_timeout();
+}
+
+uint32_t bytecode_vm::compile(term_ref t) {
+    std::unordered_map<term_ref, uint32_t>::iterator it = compiled.find(t);
+    if(it != compiled.end())
+        return it->second;
+    std::vector<uint32_t> block;
+    emit(t, block);
+    uint32_t at = code.size();
+    code.insert(code.end(), block.begin(), block.end());
+    compiled[t] = at;
+    return at;
+}
+
+void bytecode_vm::emit_push(term_ref arg, std::vector<uint32_t>& block) {
+    const term_node n = defs[arg];
+    if(n.kind == term_kind::var) {
+        block.push_back(uint32_t(opcode::push_var));
+        block.push_back(n.a);
+    } else if(n.kind == term_kind::free) {
+        block.push_back(uint32_t(opcode::push_global));
+        block.push_back(arg);
+    } else {
+        uint32_t at = compile(arg);
+        block.push_back(uint32_t(opcode::push_code));
+        block.push_back(at);
+    }
+}
+
+void bytecode_vm::emit(term_ref t, std::vector<uint32_t>& block) {
+    for(;;) {
+        const term_node n = defs[t];
+        switch(n.kind) {
+        case term_kind::var:
+            block.push_back(uint32_t(opcode::enter_var));
+            block.push_back(n.a);
+            return;
+        case term_kind::free:
+            block.push_back(uint32_t(opcode::enter_global));
+            block.push_back(t);
+            return;
+        case term_kind::lambda:
+            block.push_back(uint32_t(opcode::grab));
+            block.push_back(t);
+            t = n.a;
+            break;
+        case term_kind::apply:
+            //the outermost argument is pushed first so the innermost is on top when the head grabs
+            emit_push(n.b, block);
+            t = n.a;
+            break;
+        }
+    }
+}
+
+bytecode_thunk * bytecode_vm::lookup(term_ref id) {
+    term_ref value = defs.definition(id);
+    term_ref key = value == no_term ? id : value;
+    std::unordered_map<term_ref, bytecode_thunk*>::iterator it = globals.find(key);
+    if(it != globals.end())
+        return it->second;
+    if(value == no_term) {
+        thunks.push_back(bytecode_thunk{0, nullptr, thunk_state::evaluated, bytecode_value{true, id, nullptr, 0, nullptr}});
+    } else {
+        spend();
+        ++stats->delta;
+        thunks.push_back(bytecode_thunk{compile(value), nullptr, thunk_state::suspended, bytecode_value{}});
+    }
+    globals[key] = &thunks.back();
+    return &thunks.back();
+}
+
+bytecode_value bytecode_vm::run(uint32_t pc, bytecode_env * env) {
+    size_t base = stack.size();
+    bytecode_value v;
+    for(;;) {
+        bytecode_thunk * th = nullptr;
+        uint32_t operand = code[pc + 1];
+        switch(opcode(code[pc])) {
+        case opcode::push_var: {
+            bytecode_env * e = env;
+            for(uint32_t i = 0; i < operand; ++i)
+                e = e->next;
+            stack.push_back(frame{false, e->value});
+            pc += 2;
+            continue;
+        }
+        case opcode::push_global:
+            stack.push_back(frame{false, lookup(operand)});
+            pc += 2;
+            continue;
+        case opcode::push_code:
+            thunks.push_back(bytecode_thunk{operand, env, thunk_state::suspended, bytecode_value{}});
+            stack.push_back(frame{false, &thunks.back()});
+            pc += 2;
+            continue;
+        case opcode::grab:
+            if(stack.size() > base && !stack.back().update) {
+                spend();
+                ++stats->beta;
+                envs.push_back(bytecode_env{stack.back().thunk, env});
+                stack.pop_back();
+                env = &envs.back();
+                pc += 2;
+                continue;
+            }
+            v = bytecode_value{false, pc, env, 0, nullptr};
+            break;
+        case opcode::enter_var:
+            for(uint32_t i = 0; i < operand; ++i)
+                env = env->next;
+            th = env->value;
+            break;
+        case opcode::enter_global:
+            th = lookup(operand);
+            break;
+        }
+        if(th != nullptr) {
+            if(th->state != thunk_state::evaluated) {
+                if(!enter_thunk(*th))
+                    throw bytecode_timeout();
+                stack.push_back(frame{true, th});
+                pc = th->pc;
+                env = th->env;
+                continue;
+            }
+            v = th->value;
+        }
+
+        //return v to the stack
+        bool resumed = false;
+        while(!resumed) {
+            if(stack.size() == base)
+                return v;
+            frame& f = stack.back();
+            if(f.update) {
+                f.thunk->state = thunk_state::evaluated;
+                f.thunk->value = v;
+                ++stats->updates;
+                stack.pop_back();
+            } else if(!v.neutral) {
+                //the grab takes the argument off the stack
+                pc = v.at;
+                env = v.env;
+                resumed = true;
+            } else {
+                spines.push_back(bytecode_spine{f.thunk, v.args});
+                v.args = &spines.back();
+                stack.pop_back();
+            }
+        }
+    }
+}
+
+bytecode_value bytecode_vm::force(bytecode_thunk * th) {
+    if(th->state != thunk_state::evaluated) {
+        if(!enter_thunk(*th))
+            throw bytecode_timeout();
+        bytecode_value v = run(th->pc, th->env);
+        th->state = thunk_state::evaluated;
+        th->value = v;
+    }
+    return th->value;
+}
+
+term_ref bytecode_vm::readback(const bytecode_value& v, uint32_t depth) {
+    if(out.size() > max_readback || nesting >= max_nesting)
+        throw bytecode_timeout();
+    ++nesting;
+    term_ref ret = readback_value(v, depth);
+    --nesting;
+    return ret;
+}
+
+term_ref bytecode_vm::readback_value(const bytecode_value& v, uint32_t depth) {
+    if(!v.neutral) {
+        thunks.push_back(bytecode_thunk{0, nullptr, thunk_state::evaluated, bytecode_value{true, no_term, nullptr, depth, nullptr}});
+        envs.push_back(bytecode_env{&thunks.back(), v.env});
+        term_ref lambda = code[v.at + 1];
+        term_ref body = readback(run(v.at + 2, &envs.back()), depth + 1);
+        return out.lambda(body, defs.hint(lambda));
+    }
+    std::vector<bytecode_thunk*> args;
+    for(bytecode_spine * s = v.args; s != nullptr; s = s->prev)
+        args.push_back(s->arg);
+    term_ref ret;
+    if(v.at == no_term) {
+        ret = out.var(depth - v.level - 1);
+    } else {
+        ret = out.free(defs.free_info(v.at).name, defs.free_info(v.at).scope);
+    }
+    for(std::vector<bytecode_thunk*>::reverse_iterator it = args.rbegin(); it != args.rend(); ++it) {
+        term_ref arg = readback(force(*it), depth);
+        ret = out.apply(ret, arg);
+    }
+    return ret;
+}
+
+int bytecode_vm::normalize(component& node, int timeout, reduction_stats& stats) {
+    this->stats = &stats;
+    budget = timeout;
+    nesting = 0;
+    out = term_store();
+    int left = 0;
+    try {
+        uint32_t pc = compile(defs.from_component(node));
+        term_ref result = readback(run(pc, nullptr), 0);
+        node = out.to_component(result);
+        left = budget;
+    } catch(bytecode_timeout&) {
+        left = 0;
+    }
+    stack.clear();
+    thunks.clear();
+    envs.clear();
+    spines.clear();
+    globals.clear();
+    if(defs.size() > compact_at) {
+        defs.compact_definitions();
+        code.clear();
+        compiled.clear();
+        compact_at = std::max(min_compact, 2 * defs.size());
+    }
+    return left;
+}
+
+}
@@ -0,0 +1,121 @@
+#ifndef LAMBDA_BYTECODE_H
+#define LAMBDA_BYTECODE_H
+
+#include <deque>
+#include <unordered_map>
+#include "term.h"
+#include "engine.h"
+#include "thunk.h"
+
+namespace lambda {
+
+/**
+ * instructions of the bytecode vm. every instruction is followed by one operand word
+ **/
+enum class opcode : uint32_t {
+    push_var,     //push the argument bound `operand` lambdas up
+    push_global,  //push the value of the free identifier node `operand`
+    push_code,    //push a thunk running the code at `operand` in the current environment
+    enter_var,    //continue with the argument bound `operand` lambdas up
+    enter_global, //continue with the value of the free identifier node `operand`
+    grab          //lambda node `operand`: bind the argument on top of the stack, or return a closure if there is none
+};
+
+struct bytecode_env;
+struct bytecode_thunk;
+
+/**
+ * arguments of a stuck application, last argument first
+ **/
+struct bytecode_spine {
+    bytecode_thunk * arg;
+    bytecode_spine * prev;
+};
+
+/**
+ * a weak head normal form: either a closure (the address of a grab and its environment), or a neutral head
+ * (a variable introduced by readback or an unknown identifier) applied to arguments
+ **/
+struct bytecode_value {
+    bool neutral;
+    uint32_t at;           //closure: address of the grab. neutral: the free identifier, or no_term for a level
+    bytecode_env * env;    //closure only
+    uint32_t level;        //neutral level only
+    bytecode_spine * args; //neutral only
+};
+
+/**
+ * a suspended piece of code, overwritten with its value the first time it is entered
+ **/
+struct bytecode_thunk {
+    uint32_t pc;
+    bytecode_env * env;
+    thunk_state state;
+    bytecode_value value;
+};
+
+struct bytecode_env {
+    bytecode_thunk * value;
+    bytecode_env * next;
+};
+
+/**
+ * compiles terms to a flat array of instructions and runs them with a lazy environment machine.
+ *
+ * an application pushes its arguments and falls through to the code of its head, a lambda grabs the
+ * argument on top of the stack, and a variable enters its thunk, updating it with the value it returns. a
+ * thunk entered again before it is updated needs its own value, so that is treated like running out of steps.
+ *
+ * code is indexed by node in a shared store, so a definition is compiled once and reused by every later
+ * statement that refers to it. the terms and code of statements are left behind too, so once the store has
+ * doubled it is compacted down to the definitions and their code is compiled again as it is used.
+ **/
+class bytecode_vm {
+private:
+    /**an entry of the machine's stack: an argument waiting for a lambda, or a thunk waiting for its value**/
+    struct frame {
+        bool update;
+        bytecode_thunk * thunk;
+    };
+
+    term_store defs;
+    term_store out;
+    std::vector<uint32_t> code;
+    std::unordered_map<term_ref, uint32_t> compiled;
+
+    std::deque<bytecode_thunk> thunks;
+    std::deque<bytecode_env> envs;
+    std::deque<bytecode_spine> spines;
+    std::vector<frame> stack;
+    std::unordered_map<term_ref, bytecode_thunk*> globals;
+    /**size of `defs` past which normalize() drops everything but the definitions**/
+    size_t compact_at;
+    reduction_stats * stats;
+    long budget;
+    int nesting;
+
+    uint32_t compile(term_ref t);
+    void emit(term_ref t, std::vector<uint32_t>& block);
+    void emit_push(term_ref arg, std::vector<uint32_t>& block);
+    bytecode_thunk * lookup(term_ref id);
+    bytecode_value run(uint32_t pc, bytecode_env * env);
+    bytecode_value force(bytecode_thunk * th);
+    term_ref readback(const bytecode_value& v, uint32_t depth);
+    term_ref readback_value(const bytecode_value& v, uint32_t depth);
+    void spend();
+public:
+    bytecode_vm();
+
+    /**number of instruction words compiled so far**/
+    size_t code_size() const { return code.size(); }
+
+    /**
+     * replaces `node` with its normal form. returns the unused part of `timeout`, or 0 if it ran out, in which
+     * case `node` is left as it was
+     **/
+    int normalize(component& node, int timeout, reduction_stats& stats);
+};
+
+}
+
+#endif
@@ -2,42 +2,108 @@
 #include "emit.h"
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include "term.h"
+#include "trace.h"
+#include "profile.h"
 
 
 namespace lambda {
 
+/**
+ * whether `node` is an identifier that was resolved to one of the open packages when it was read, as a name
+ * being redefined is
+ **/
+static bool resolved_in_open(const component& node, const std::vector<std::string>& pkgs, global_package& ctx) {
+    for(const std::string& p : pkgs) {
+        if(node.scope() == ctx.get_package(p))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * evaluates `in` again with component::evaluate, and warns if it does not
+ * agree with `result`. the rewrite engine leaves some redexes the other engines reduce, so when the two
+ * differ the rewrite result is normalized with `with` before comparing again
+ **/
+static void verify(const component& in, const component& result, engine with, int timeout, int line, std::string filename) {
+    component by_rewrite = in;
+    int left = by_rewrite.evaluate(timeout);
+    if(left == 0)
+        return;
+
+    term_store store;
+    term_ref expected = store.from_component(result);
+    if(store.compare(store.from_component(by_rewrite), expected))
+        return;
+    reduction_stats stats;
+    if(normalize(by_rewrite, timeout, with, stats) == 0 || !store.compare(store.from_component(by_rewrite), expected)) {
+        emit_warning("result does not match the rewrite engine, which gives " + by_rewrite.to_string(), line, filename);
+    }
+}
 
-int load_file(std::string filename) {
-    static const int TIMEOUT = 100000;
+/**
+ * reads a `;!` setting for the next statement into `steps` or `tuning`. the settings are `steps N`, the most
+ * steps the statement may take, and `strategy NAME`, the order the rewrite engine reduces it in
+ **/
+static void read_pragma(const compact_token& tik, engine with, int& steps, engine_options& tuning) {
+    std::string_view::size_type space = tik.info.find(' ');
+    std::string name(tik.info.substr(0, space));
+    std::string value(space == std::string_view::npos ? "" : tik.info.substr(tik.info.find_first_not_of(" \t", space)));
+    if(name == "steps") {
+        bool valid = !value.empty() && value.size() < 10;
+        for(char c : value)
+            valid = valid && is_num(c);
+        if(valid && std::stoi(value) > 0) {
+            steps = std::stoi(value);
+        } else {
+            emit_warning("ignoring invalid step budget '" + value + "'", tik.line_num, tik.filename());
+        }
+    } else if(name == "strategy") {
+        if(!strategy_from_string(value, tuning.strategy)) {
+            emit_warning("ignoring unknown reduction strategy '" + value + "'", tik.line_num, tik.filename());
+        } else if(with != engine::rewrite) {
+            emit_warning("reduction strategies only apply to the rewrite engine", tik.line_num, tik.filename());
+        }
+    } else {
+        emit_warning("ignoring unknown setting '" + name + "'", tik.line_num, tik.filename());
+    }
+}
+
+int load_file(std::string filename, global_package& ctx, const load_options& opts) {
 
-    std::ifstream ifs(filename, std::ifstream::in);
-    if(!ifs.is_open()) {
+    source_text source;
+    if(!source.map(filename)) {
         return 0;
     }
 
-    std::vector<token> tok = tokenize(ifs, filename);
+    std::vector<compact_token>& tok = source.tokens();
     if(!tok.empty())
-        tok.push_back(token{token_type::newline,"",tok.back().tt == token_type::newline ? tok.back().line_num + 1 : tok.back().line_num,filename});
-
-    ifs.close();
+        tok.push_back(compact_token{token_type::newline,{},tok.back().tt == token_type::newline ? tok.back().line_num + 1 : tok.back().line_num,tok.back().file});
 
     nullable<std::string> definition;
     bool lazy_def = true;
 
     component* node = new component();
+    trace_sink null_trace;
+    trace_sink& trace = opts.tuning.trace != nullptr ? *opts.tuning.trace : null_trace;
+    //what the next statement is evaluated with, which `;!` settings change for that statement only
+    int steps = opts.steps;
+    engine_options tuning = opts.tuning;
 
     std::vector<std::string> pkgs;
     std::vector<component*> parens;
     std::vector<std::string> files;
 
-    for(std::vector<token>::iterator tik = tok.begin(); tik != tok.end(); ++tik) {
+    for(std::vector<compact_token>::iterator tik = tok.begin(); tik != tok.end(); ++tik) {
         std::vector<std::string>::iterator index;
         package * scope;
         component* oldnode = nullptr;
         bool bound, complete;
         switch(tik->tt) {
         case token_type::lambda:
-            std::cout << "L";
+            trace.echo("L");
 
             parens.push_back(node);
             node = new component();
@@ -50,51 +116,53 @@ int load_file(std::string filename) {
 
             ++tik;
             if(tik->tt == token_type::dot || tik->tt == token_type::lparen) {
-                emit_error("lambda cannot have zero arguments", tik->line_num, tik->filename);
+                emit_error("lambda cannot have zero arguments", tik->line_num, tik->filename());
             }
 
             while(tik->tt != token_type::dot && tik->tt != token_type::lparen && tik != tok.end()) {
                 if(tik->tt != token_type::identifier) {
-                    emit_error("lambda argument must be an identifier", tik->line_num, tik->filename);
+                    emit_error("lambda argument must be an identifier", tik->line_num, tik->filename());
                 }
                 //TODO check that id name is valid
-                node->lambda(component().id(tik->info), component());
+                node->lambda(component().id(tik->sym), component());
                 node = &node->lambda_out();
                 if(tik->info.size() == 0) {
-                    emit_error("zero length identifier", tik->line_num, tik->filename);
+                    emit_error("zero length identifier", tik->line_num, tik->filename());
                     break;
                 } else if((tik->info.size() == 1 || tik->info[1] == '\'') && tik->info[0] != 'L') {
-                    std::cout << tik->info;
+                    trace.echo(tik->info);
                 } else {
-                    std::cout << "`" << tik->info << " ";
+                    trace.echo("`");
+                    trace.echo(tik->info);
+                    trace.echo(" ");
                 }
                 ++tik;
             }
             node = oldnode;
             if(tik == tok.end()) {
-                emit_error("program ended before statement completion", tok.back().line_num, tok.back().filename);
+                emit_error("program ended before statement completion", tok.back().line_num, tok.back().filename());
             } 
             if(tik->tt == token_type::dot) {
-                std::cout << ".";
+                trace.echo(".");
             } else /*lparen*/ {
                 parens.push_back(new component());
-                std::cout << "(";
+                trace.echo("(");
             }
             break;
         case token_type::dot:
-            emit_error("stray '.' in program", tik->line_num, tik->filename);
+            emit_error("stray '.' in program", tik->line_num, tik->filename());
             break;
         case token_type::define:
         case token_type::lazy_define:
             if(!parens.empty()) {
-                emit_error("cannot have definition within an expression", tik->line_num, tik->filename);
+                emit_error("cannot have definition within an expression", tik->line_num, tik->filename());
                 break;
             }
             if(!definition.null()) {
-                emit_error("cannot have multiple defintions in the same statement", tik->line_num, tik->filename);
+                emit_error("cannot have multiple defintions in the same statement", tik->line_num, tik->filename());
                 break;
             }
-            if(node->is_id() && node->parent() == nullptr && node->scope() == &prepkg::global) {
+            if(node->is_id() && node->parent() == nullptr && (node->scope() == ctx.global_scope() || resolved_in_open(*node, pkgs, ctx))) {
                 definition = node->id_name();
                 if(tik->tt == token_type::define) {
                     lazy_def = false;
@@ -104,112 +172,131 @@ int load_file(std::string filename) {
                 node->clear();
             } else {
                 if(!node->is_init()) {
-                    emit_error("definition has no target", tik->line_num, tik->filename);
+                    emit_error("definition has no target", tik->line_num, tik->filename());
                 } else {
-                    emit_error("only identifiers can be defined", tik->line_num, tik->filename);
+                    emit_error("only identifiers can be defined", tik->line_num, tik->filename());
                 }
             }
             if(tik->tt == token_type::define) {
-                std::cout << " := ";
+                trace.echo(" := ");
             } else {
-                std::cout << " => ";
+                trace.echo(" => ");
             }
             break;
         case token_type::inductive_definition:
-            emit_error("inductive definitons not supported", tik->line_num, tik->filename);
-            std::cout << " ...= ";
+            emit_error("inductive definitons not supported", tik->line_num, tik->filename());
+            trace.echo(" ...= ");
             break;
         case token_type::identifier:
             if(tik->info.size() == 0) {
-                emit_error("zero length identifier", tik->line_num, tik->filename);
+                emit_error("zero length identifier", tik->line_num, tik->filename());
                 break;
             } else if((tik->info.size() == 1 || tik->info[1] == '\'') && tik->info[0] != 'L') {
-                std::cout << tik->info;
+                trace.echo(tik->info);
             } else {
-                std::cout << "`" << tik->info << " ";
+                trace.echo("`");
+                trace.echo(tik->info);
+                trace.echo(" ");
             }
-            bound = node->is_lambda() ? node->lambda_has_arg(tik->info) : 0;
+            bound = node->is_lambda() ? node->lambda_has_arg(tik->sym) : 0;
             for(component * par : parens) { 
                 if(bound)
                     break;
-                bound = par->is_lambda() ? par->lambda_has_arg(tik->info) : 0;
+                bound = par->is_lambda() ? par->lambda_has_arg(tik->sym) : 0;
             }
             if(bound) {
-                node->append(component().id(tik->info));
+                node->append(component().id(tik->sym));
             } else {
-                //TODO get more specific packages if able
-                //error if not found
-                node->append(component().id(tik->info, &prepkg::global));
+                //a name already defined in an open package refers to that definition, innermost package first.
+                //anything else is looked up in the global scope, which also sees later definitions
+                scope = ctx.global_scope();
+                for(std::vector<std::string>::reverse_iterator pki = pkgs.rbegin(); pki != pkgs.rend(); ++pki) {
+                    package * p = ctx.get_package(*pki);
+                    if(p->get_value(tik->sym) != nullptr) {
+                        scope = p;
+                        break;
+                    }
+                }
+                node->append(component().id(tik->sym, scope));
             }
             break;
         case token_type::file:
             if(node->is_init() || !parens.empty()) {
-                emit_warning("inserting file within an expression", tik->line_num, tik->filename);
+                emit_warning("inserting file within an expression", tik->line_num, tik->filename());
             }
             if(/*file not opened yet*/1) {
                 //TODO search for the file in viable spots relative to open file before including
-                if(!load_file(tik->info)) {
-                    emit_error("could not open file", tik->line_num, tik->filename);
+                if(!load_file(std::string(tik->info), ctx, opts)) {
+                    emit_error("could not open file", tik->line_num, tik->filename());
                 }
             } else {
-                emit_warning("skipping repeated file", tik->line_num, tik->filename);
+                emit_warning("skipping repeated file", tik->line_num, tik->filename());
             }
-            std::cout << "\"" << tik->info << "\"";
+            trace.echo("\"");
+            trace.echo(tik->info);
+            trace.echo("\"");
             break;
         case token_type::package_begin:
             //TODO check if package has a valid name
             if(std::find(pkgs.begin(), pkgs.end(), tik->info) == pkgs.end()) {
-                global.add_package(tik->info);
-                pkgs.push_back(tik->info);
+                ctx.add_package(std::string(tik->info));
+                pkgs.push_back(std::string(tik->info));
             } else {
-                emit_warning("began package twice", tik->line_num, tik->filename);
+                emit_warning("began package twice", tik->line_num, tik->filename());
             }
-            std::cout << tik->info << "::\n";
+            trace.echo(tik->info);
+            trace.echo("::\n");
             break;
         case token_type::package_end:
             index = std::find(pkgs.begin(), pkgs.end(), tik->info);
             if(index != pkgs.end()) {
                 pkgs.erase(index);
             } else {
-                emit_warning("cannot end package since it was not begun", tik->line_num, tik->filename);
+                emit_warning("cannot end package since it was not begun", tik->line_num, tik->filename());
             }
-            std::cout << "::" << tik->info << "\n";
+            trace.echo("::");
+            trace.echo(tik->info);
+            trace.echo("\n");
             break;
         case token_type::package_scope:
-            scope = global.get_package(tik->info);
+            scope = ctx.get_package(std::string(tik->info));
             if(scope == nullptr) {
-                emit_warning("could not find the specified package. defaulting to global scope.", tik->line_num, tik->filename);
-                scope = &prepkg::global;
+                emit_warning("could not find the specified package. defaulting to global scope.", tik->line_num, tik->filename());
+                scope = ctx.global_scope();
             }
-            std::cout << ":" << tik->info << ":";
+            trace.echo(":");
+            trace.echo(tik->info);
+            trace.echo(":");
             ++tik;
             if(tik->tt != token_type::identifier) {
-                emit_error("package scope must be followed by an identifier", tik->line_num, tik->filename);
+                emit_error("package scope must be followed by an identifier", tik->line_num, tik->filename());
                 --tik;
             } else {
-                const component * value = scope ? scope->get_value(tik->info) : global.get_value(tik->info);
+                const component * value = scope ? scope->get_value(std::string(tik->info)) : ctx.get_value(std::string(tik->info));
                 if(value == nullptr) {
-                    emit_warning("could not find variable in the specified scope", tik->line_num, tik->filename);
+                    emit_warning("could not find variable in the specified scope", tik->line_num, tik->filename());
                 }
                 if(tik->info.size() == 0) {
-                    emit_error("zero length identifier", tik->line_num, tik->filename);
+                    emit_error("zero length identifier", tik->line_num, tik->filename());
                     break;
                 } else if((tik->info.size() == 1 || tik->info[1] == '\'') && tik->info[0] != 'L') {
-                    std::cout << tik->info;
+                    trace.echo(tik->info);
                 } else {
-                    std::cout << "`" << tik->info << " ";
+                    trace.echo("`");
+                    trace.echo(tik->info);
+                    trace.echo(" ");
                 }
-                node->append(component().id(tik->info, scope ?: &prepkg::global));
+                node->append(component().id(tik->sym, scope ?: ctx.global_scope()));
             }
             break;
         case token_type::lparen:
             parens.push_back(node);
             node = new component();
-            std::cout << "(";
+            trace.echo("(");
             break;
         case token_type::rparen:
             if(parens.empty()) {
-                emit_error("encountered ')' with no matching '('", tik->line_num, tik->filename);
+                emit_error("encountered ')' with no matching '('", tik->line_num, tik->filename());
             } else {
                 while(!parens.empty() && node->is_lambda()) {
                     oldnode = node;
@@ -229,10 +316,10 @@ int load_file(std::string filename) {
                     node->append(std::move(*oldnode));
                     delete oldnode;
                 } else {
-                    emit_error("encountered ')' with no matching '('", tik->line_num, tik->filename);
+                    emit_error("encountered ')' with no matching '('", tik->line_num, tik->filename());
                 }
 
-                std::cout << ")";
+                trace.echo(")");
             }
             break;
         case token_type::newline:
@@ -256,15 +343,32 @@ int load_file(std::string filename) {
                 }
                 node->collapse();
                 if(!node->is_deep_init()) {
-                    emit_error("incomplete statement", tik->line_num, tik->filename);
+                    emit_error("incomplete statement", tik->line_num, tik->filename());
                     node->clear();
+                    steps = opts.steps;
+                    tuning = opts.tuning;
                     break;
                 }
-                int timeout = node->evaluate(TIMEOUT);
+                component before;
+                if(opts.verify && opts.with != engine::rewrite)
+                    before = *node;
+                trace.statement(*node, tik->line_num, tik->filename());
+                reduction_stats stats;
+                if(tuning.profile != nullptr)
+                    tuning.profile->statement(tik->line_num, tik->filename());
+                work_counters snapshot = snapshot_counters();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                int timeout = normalize(*node, steps, opts.with, stats, tuning);
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                trace.work(counted_since(snapshot));
 
-                std::cout << "\n    " << node->to_string() << "[" << (TIMEOUT - timeout) << "]";
+                trace.result(*node, steps - timeout, opts.with != engine::rewrite ? &stats : nullptr,
+                    opts.time ? elapsed.count() : -1);
                 if(timeout == 0) {
-                    emit_warning("stopped evaluating lambda after timeout",tik->line_num,tik->filename);
+                    emit_warning("stopped evaluating lambda after timeout",tik->line_num,tik->filename());
+                    trace.timeout(tik->line_num, tik->filename());
+                } else if(opts.verify && opts.with != engine::rewrite) {
+                    verify(before, *node, opts.with, steps, tik->line_num, tik->filename());
                 }
                 
                 if(definition.null() || !lazy_def) {
@@ -272,31 +376,39 @@ int load_file(std::string filename) {
                         int timeleft = node->simplify(timeout);
                         std::cout << "\n    " << node->to_string() << "[" << (timeout - timeleft) << "]";
                         if(timeout == 0) {
-                            emit_warning("stopped evaluating lambda after timeout",tik->line_num,tik->filename);
+                            emit_warning("stopped evaluating lambda after timeout",tik->line_num,tik->filename());
                         }
                     }*/
                 }
                 if(!definition.null()) {
+                    //a value is charged to whatever expands it, not to the statement that defined it
+                    if(tuning.profile != nullptr)
+                        node->clear_origins();
                     for (std::string p : pkgs) {
-                        if (global.get_package(p)->get_value(definition) != nullptr) {
-                            emit_warning("redefining variable within package", tik->line_num, tik->filename);
+                        if (ctx.get_package(p)->get_value(definition) != nullptr) {
+                            emit_warning("redefining variable within package", tik->line_num, tik->filename());
                         }
-                        global.get_package(p)->add_value(definition, *node);
+                        ctx.get_package(p)->add_value(definition, *node);
                     }
                     if (pkgs.empty()) {
-                        if (global.get_value(definition) != nullptr) {
-                            emit_warning("redefining variable in global space", tik->line_num, tik->filename);
+                        if (ctx.get_value(definition) != nullptr) {
+                            emit_warning("redefining variable in global space", tik->line_num, tik->filename());
                         }
-                        global.add_value(definition, *node);
+                        ctx.add_value(definition, *node);
                     }
+                    trace.definition(definition, *node);
                     definition.nullify();
                 }
                 node->clear();
-                std::cout << "\n";
+                steps = opts.steps;
+                tuning = opts.tuning;
             } //else ignore
             break;
+        case token_type::pragma:
+            read_pragma(*tik, opts.with, steps, tuning);
+            break;
         case token_type::none:
-            emit_error("unrecognized token", tik->line_num, tik->filename);
+            emit_error("unrecognized token", tik->line_num, tik->filename());
             break;
         }
     }
@@ -311,19 +423,5 @@ int evaluate_line(std::vector<token> line, int max_steps) {
     return 0;
 }
 
-}
-
-
-using namespace lambda;
 
-int main(int argc, char ** argv) {
-    if(argc <= 1) {
-        std::cout << "must input a file";
-        return 1;
-    }
-    load_file(argv[1]);
-    return 0;
 }
-
-
-
@@ -3,10 +3,30 @@
 
 #include "token.h"
 #include "component.h"
+#include "engine.h"
 
 namespace lambda {
 
-int load_file(std::string filename);
+/**
+ * settings that apply to every statement of a loaded file (and the files it includes)
+ **/
+struct load_options {
+    engine with = engine::rewrite;
+    /**print how long each statement took to evaluate**/
+    bool time = false;
+    /**check every result of a non-rewrite engine against component::evaluate**/
+    bool verify = false;
+    /**steps each statement may take, unless a `;! steps` setting gives it its own**/
+    int steps = 100000;
+    /**passed on to normalize() for every statement**/
+    engine_options tuning;
+};
+
+/**
+ * reads and evaluates every statement of `filename`, adding its definitions to `ctx`. returns 0 if the file
+ * could not be opened
+ **/
+int load_file(std::string filename, global_package& ctx, const load_options& opts = load_options());
 
 int evaluate_line(std::vector<token> line, int max_steps = 1024);
 
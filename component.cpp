@@ -1,65 +1,114 @@
 #include "component.h"
 #include "token.h"
+#include "memo.h"
+#include "native.h"
+#include "trace.h"
+#include "profile.h"
 #include <algorithm>
+#include <iterator>
+#include <unordered_set>
 
 namespace lambda {
 
-int component::replace_ids(std::string replace_name, const component& replace, package * replace_scope) {
-    if (is_id()) {
-        if (id_name() == replace_name && scope() == replace_scope) {
-            copy_preserve_parent(replace);
-            return 1;
-        } else {
-            return 0;
-        }
+void component::find_ids(symbol name, package * scope, std::vector<component*>& found) {
+    if (scope == &prepkg::bound && !bound_from_above(name)) {
+        return;
+    } else if (is_id()) {
+        if (id_symbol() == name && this->scope() == scope)
+            found.push_back(this);
     } else if (is_expr()) {
-        return expr_head().replace_ids(replace_name, replace, replace_scope) + 
-            expr_tail().replace_ids(replace_name, replace, replace_scope);
+        expr_head().find_ids(name, scope, found);
+        expr_tail().find_ids(name, scope, found);
     } else if (is_lambda()) {
-        if(replace_scope == &prepkg::bound && lambda_arg().id_name() == replace_name) {
-            return 0;
-        } else {
-            return lambda_out().replace_ids(replace_name, replace, replace_scope);
-        }
+        if(scope != &prepkg::bound || lambda_arg().id_symbol() != name)
+            lambda_out().find_ids(name, scope, found);
+    } else {
+        throw std::logic_error("component not a lambda, expression, or identifier");
     }
-    throw std::logic_error("component not a lambda, expression, or identifier");
+}
+
+int component::replace_ids(symbol replace_name, const component& replace, package * replace_scope) {
+    std::vector<component*> found;
+    find_ids(replace_name, replace_scope, found);
+    for(component * id : found)
+        id->copy_preserve_parent(replace);
+    return found.size();
+}
+
+int component::replace_ids(symbol replace_name, component&& replace, package * replace_scope) {
+    std::vector<component*> found;
+    find_ids(replace_name, replace_scope, found);
+    if(found.empty())
+        return 0;
+    for(std::vector<component*>::iterator it = found.begin(); it + 1 != found.end(); ++it)
+        (*it)->copy_preserve_parent(replace);
+    found.back()->copy_preserve_parent(std::move(replace));
+    return found.size();
+}
+
+/**
+ * replaces the identifier `id` with `value`. when profiling, the value is tagged with the definition it came
+ * from and the expansion charged to it
+ **/
+static void expand(component& id, const component& value) {
+    ++counters.delta;
+    if(profiling == nullptr) {
+        id.copy_preserve_parent(value);
+        return;
+    }
+    const profile_frame * frame = profile_child(profiling->frame_of(id), id.id_symbol());
+    long allocated = counters.allocated;
+    id.copy_preserve_parent(value);
+    id.origin() = frame;
+    profiling->charge(frame, 0, counters.allocated - allocated);
 }
 
 int component::evaluate_expression() {
     int ret = 0;
     if(expr_head().is_id() && expr_head().scope() != &prepkg::bound) {
-        const component * id_value = nullptr;
-        if(expr_head().scope() == &prepkg::global) {
-            id_value = global.get_value(expr_head().id_name());
-        } else {
-            id_value = expr_head().scope()->get_value(expr_head().id_name());
-        }
+        const component * id_value = expr_head().id_value();
         if(id_value != nullptr) {
-            expr_head().copy_preserve_parent(*id_value);
+            expand(expr_head(), *id_value);
             ret = 1;
         } else {
             return 0;
         }
     }
     if (expr_head().is_lambda()) {
+        //the body and argument take the place of the lambda, so they keep the frames they were in
+        const profile_frame * frame = nullptr;
+        long allocated = counters.allocated;
+        if(profiling != nullptr) {
+            frame = profiling->frame_of(expr_head());
+            if(expr_head().lambda_out().origin() == nullptr)
+                expr_head().lambda_out().origin() = frame;
+            if(expr_tail().origin() == nullptr)
+                expr_tail().origin() = profiling->frame_of(expr_tail());
+        }
+
         component * node = &expr_head().lambda_out();
         while(node->is_lambda()) {
-            if(expr_tail().bound_from_above(node->lambda_arg().id_name())) {
+            if(expr_tail().bound_from_above(node->lambda_arg().id_symbol())) {
                 unsigned rev = 0;
-                std::string base = base_name(node->lambda_arg().id_name());
-                std::string alt = alt_name(base, rev);
+                symbol base = base_name(node->lambda_arg().id_symbol());
+                symbol alt = alt_name(base, rev);
                 while(expr_tail().bound_from_above(alt) || node->lambda_out().bound_above_below(alt)) {
                     ++rev;
                     alt = alt_name(base, rev);
                 }
-                node->lambda_out().replace_ids(node->lambda_arg().id_name(), component().id(alt), &prepkg::bound);
-                node->lambda_arg().id_name() = alt;
+                node->lambda_out().replace_ids(node->lambda_arg().id_symbol(), component().id(alt), &prepkg::bound);
+                node->lambda_arg().id_symbol(alt);
+                ++counters.renames;
             }
             node = &node->lambda_out();
         }
 
-        expr_head().lambda_out().replace_ids(expr_head().lambda_arg().id_name(), expr_tail());
-        copy_preserve_parent(expr_head().lambda_out());
+        //the argument and body are discarded once they are in place, so they are moved rather than copied
+        expr_head().lambda_out().replace_ids(expr_head().lambda_arg().id_symbol(), std::move(expr_tail()));
+        copy_preserve_parent(std::move(expr_head().lambda_out()));
+        ++counters.beta;
+        if(profiling != nullptr)
+            profiling->charge(frame, 1, counters.allocated - allocated);
         return 1;
     }
     return ret;
@@ -82,37 +131,284 @@ int component::simplify_step() {
         }
     } else if (is_lambda()) {
         return lambda_out().simplify_step();
-    } else if (scope() == &prepkg::global) {
-        const component * value = global.get_value(id_name());
+    } else {
+        const component * value = id_value();
         if(value == nullptr) {
             return 0;
         } else {
-            copy_preserve_parent(*value);
+            expand(*this, *value);
             return 1;
         }
-    } else if (scope() == &prepkg::bound) {
-        return 0;
-    } else {
-        const component * value = scope()->get_value(id_name());
-        if(value == nullptr) {
-            return 0;
+    }
+}
+
+/**
+ * a node on the path from the root to the current focus of evaluate(), and how far its part of the
+ * leftmost-outermost search has gotten
+ **/
+struct eval_frame {
+    component * node;
+    enum {
+        start,      //not searched yet
+        after_head, //head (or lambda body) has no step
+        after_tail  //tail has no step, or was not searched
+    } phase;
+    /**index of the node's copy in eval_state::keys while it is being reduced for the cache, otherwise -1**/
+    int memo;
+    /**eval_state::clock when the node was first entered, -1 before**/
+    int entered;
+};
+
+/**
+ * what evaluate() keeps between steps besides the path.
+ *
+ * with a normal_form_cache, a closed subterm that is not in the cache is reduced in place as usual, and since
+ * the search only leaves it once it has no more steps, it is added to the cache with the steps taken in
+ * between when its frame is popped
+ **/
+struct eval_state {
+    normal_form_cache * cache;
+    church_natives * natives;
+    /**what native numerals are built with, see church_natives::build()**/
+    reduction_strategy strategy;
+    /**copies of the subterms being reduced for the cache, as they were when entered**/
+    std::vector<component> keys;
+    /**steps taken so far by the evaluate() loop**/
+    int clock;
+    /**steps left. a shortcut that would take more than this is not used, so timeouts stay where they were**/
+    int budget;
+    /**steps a shortcut counts for beyond the one the loop charges**/
+    int skipped;
+};
+
+/**
+ * looks the node `top` was just entered on up in the cache. on a hit the node is replaced with its normal form
+ * and true is returned, otherwise a copy of it is kept so it can be added once it has been reduced
+ **/
+static bool memo_enter(eval_frame& top, eval_state& state) {
+    if(!normal_form_cache::cacheable(*top.node))
+        return false;
+    int steps;
+    const component * normal = state.cache->find(*top.node, steps);
+    if(normal != nullptr && steps - 1 <= state.budget) {
+        top.node->copy_preserve_parent(*normal);
+        state.skipped = steps - 1;
+        return true;
+    }
+    top.memo = state.keys.size();
+    state.keys.push_back(*top.node);
+    return false;
+}
+
+/**pops the frame of a node with no more steps, adding it to the cache if it was reduced for it**/
+static void memo_leave(std::vector<eval_frame>& path, eval_state& state) {
+    eval_frame& top = path.back();
+    if(top.memo >= 0) {
+        int steps = state.clock - top.entered;
+        //a native numeral is not what the node reduces to, only what it stands for
+        if(steps > 0 && (state.natives == nullptr || !state.natives->has_numeral(*top.node)))
+            state.cache->insert(state.keys[top.memo], *top.node, steps);
+        state.keys.pop_back();
+    }
+    path.pop_back();
+}
+
+/**
+ * the strategies of component::evaluate, as policies of resume_step(). `search_head` and `search_tail` say
+ * whether the parts of an application are searched for steps before it is contracted (if its head is a
+ * lambda), and `under_lambda` whether lambda bodies are. `normalizes` is true for strategies that only stop
+ * at a normal form, which are the ones that can use native arithmetic
+ **/
+struct normal_order_policy {
+    static const bool under_lambda = true;
+    static const bool normalizes = true;
+    static bool search_head(const component&) {
+        return true;
+    }
+    static bool search_tail(const component& expr) {
+        const component& head = expr.expr_head();
+        return !((head.is_expr() || head.is_id()) && head.has_unknown()) &&
+            !(head.is_lambda() && !head.lambda_unknown_before_arg()); //otherwise value might not even be used
+    }
+};
+
+struct applicative_policy {
+    static const bool under_lambda = true;
+    static const bool normalizes = true;
+    static bool search_head(const component&) {
+        return true;
+    }
+    static bool search_tail(const component&) {
+        return true;
+    }
+};
+
+struct weak_head_policy {
+    static const bool under_lambda = false;
+    static const bool normalizes = false;
+    static bool search_head(const component& expr) {
+        return !expr.expr_head().is_lambda();
+    }
+    static bool search_tail(const component&) {
+        return false;
+    }
+};
+
+struct head_normal_policy {
+    static const bool under_lambda = true;
+    static const bool normalizes = false;
+    static bool search_head(const component& expr) {
+        return !expr.expr_head().is_lambda();
+    }
+    static bool search_tail(const component&) {
+        return false;
+    }
+};
+
+struct closed_by_value_policy {
+    static const bool under_lambda = true;
+    static const bool normalizes = true;
+    static bool search_head(const component&) {
+        return true;
+    }
+    static bool search_tail(const component& expr) {
+        return normal_order_policy::search_tail(expr) ||
+            (expr.expr_head().is_lambda() && !expr.expr_tail().has_unknown());
+    }
+};
+
+/**
+ * continues the search for the next step from the focus at the top of `path` instead of from the root. in
+ * normal order this is the search done by evaluate_step().
+ *
+ * a contraction only changes the subtree it happened in, and every decision made by an ancestor on the path
+ * depends only on subtrees left of the focus, so resuming here takes the same step a search from the root
+ * would. on success the focus is left on the node that changed, ready to be searched again
+ **/
+template<class policy>
+static int resume_step(std::vector<eval_frame>& path, eval_state& state) {
+    while(!path.empty()) {
+        eval_frame& top = path.back();
+        component * node = top.node;
+        if(node->is_expr()) {
+            if(top.phase == eval_frame::start) {
+                //only on first entry; once contracted the node's later forms belong to the same entry
+                if(state.cache != nullptr && top.entered < 0) {
+                    top.entered = state.clock;
+                    if(memo_enter(top, state)) {
+                        path.pop_back();
+                        return 1;
+                    }
+                }
+                //the result is searched like any other term, so a pending cache entry still gets added
+                if(state.natives != nullptr && state.natives->apply(*node, state.budget, state.skipped))
+                    return 1;
+                top.phase = eval_frame::after_head;
+                if(policy::search_head(*node))
+                    path.push_back(eval_frame{&node->expr_head(), eval_frame::start, -1, -1});
+            } else if(top.phase == eval_frame::after_head) {
+                top.phase = eval_frame::after_tail;
+                if(policy::search_tail(*node))
+                    path.push_back(eval_frame{&node->expr_tail(), eval_frame::start, -1, -1});
+            } else {
+                if(node->expr_head().is_lambda()) {
+                    top.phase = eval_frame::start;
+                    return node->evaluate_expression();
+                }
+                memo_leave(path, state);
+            }
+        } else if(node->is_lambda()) {
+            if(policy::under_lambda && top.phase == eval_frame::start) {
+                top.phase = eval_frame::after_head;
+                path.push_back(eval_frame{&node->lambda_out(), eval_frame::start, -1, -1});
+            } else {
+                memo_leave(path, state);
+            }
+        } else if(node->is_id()) {
+            if(state.natives != nullptr && state.natives->is_numeral(*node)) {
+                //a native numeral is only built once something is applied to it
+                component * parent = node->parent();
+                if(parent == nullptr || !parent->is_expr() || &parent->expr_head() != node) {
+                    memo_leave(path, state);
+                    continue;
+                }
+                int used = state.natives->build(*node, state.budget + 1, state.strategy);
+                state.skipped = used < 0 ? state.budget : std::max(used - 1, 0);
+                return 1;
+            }
+            if(node->evaluate_step())
+                return 1;
+            memo_leave(path, state);
         } else {
-            copy_preserve_parent(*value);
-            return 1;
+            throw std::logic_error("cannot evaluate uninitialized expression");
         }
     }
+    return 0;
 }
 
-int component::evaluate(int timeout) {
+/**
+ * a strategy that reduces arguments before they are used can grow a term on every step without end, so a term
+ * that grows past this many nodes is treated as a timeout, like the size limit of parallel_engine. it is lower
+ * than that one because copying, printing and freeing a component recurse as deep as the term goes
+ **/
+static const size_t max_size = 1 << 18;
+
+/**the loop of component::evaluate, with the strategy fixed so that its choices are inlined into the search**/
+template<class policy>
+static int evaluate_with(component& root, int timeout, eval_state& state, trace_sink * trace) {
+    std::vector<eval_frame> path;
+    path.push_back(eval_frame{&root, eval_frame::start, -1, -1});
+    if(!policy::normalizes)
+        state.natives = nullptr;
     while(timeout > 0) {
-        std::cout << "\n     " << to_string();
+        if(trace != nullptr)
+            trace->step(root);
         --timeout;
-        if(!evaluate_step())
+        state.budget = timeout;
+        state.skipped = 0;
+        if(!resume_step<policy>(path, state))
+            break;
+        ++state.clock;
+        state.clock += state.skipped;
+        timeout -= state.skipped;
+        //only the path to the node that changed is uncached, so this is not a walk of the whole term
+        if(root.size() > max_size) {
+            timeout = 0;
             break;
+        }
+    }
+    //what is left of native numerals is seen, so it is built as reduction would have left it
+    if(state.natives != nullptr && timeout > 0) {
+        int used = state.natives->build(root, timeout, state.strategy);
+        timeout = used < 0 ? 0 : timeout - used;
     }
+    if(state.natives != nullptr && timeout == 0)
+        state.natives->unbuild(root);
     return timeout;
 }
 
+int component::evaluate(int timeout, normal_form_cache * memo, church_natives * natives, trace_sink * trace,
+        reduction_strategy strategy) {
+    //cached normal forms are what normal order leaves, which another strategy might not reach or go past
+    eval_state state{strategy == reduction_strategy::normal_order ? memo : nullptr, natives, strategy,
+        std::vector<component>(), 0, 0, 0};
+    if(trace != nullptr && !trace->wants_steps())
+        trace = nullptr;
+    switch(strategy) {
+    case reduction_strategy::normal_order:
+        return evaluate_with<normal_order_policy>(*this, timeout, state, trace);
+    case reduction_strategy::applicative:
+        return evaluate_with<applicative_policy>(*this, timeout, state, trace);
+    case reduction_strategy::weak_head:
+        return evaluate_with<weak_head_policy>(*this, timeout, state, trace);
+    case reduction_strategy::head_normal:
+        return evaluate_with<head_normal_policy>(*this, timeout, state, trace);
+    case reduction_strategy::closed_by_value:
+        return evaluate_with<closed_by_value_policy>(*this, timeout, state, trace);
+    }
+    throw std::logic_error("unknown reduction strategy");
+}
+
 int component::simplify(int timeout) {
     while(timeout > 0) {
         // std::cout << "\n     " << to_string();
@@ -123,40 +419,106 @@ int component::simplify(int timeout) {
     return timeout;
 }
 
+/**
+ * union of two sorted name sets. the result shares one of the inputs whenever it can, which is the common
+ * case, since most subtrees only use names the rest of the term already uses
+ **/
+static std::shared_ptr<const std::vector<symbol>> merge_names(
+        const std::shared_ptr<const std::vector<symbol>>& a, const std::shared_ptr<const std::vector<symbol>>& b) {
+    if(a == b || b->empty() || std::includes(a->begin(), a->end(), b->begin(), b->end()))
+        return a;
+    if(a->empty() || std::includes(b->begin(), b->end(), a->begin(), a->end()))
+        return b;
+    std::vector<symbol> ret;
+    ret.reserve(a->size() + b->size());
+    std::set_union(a->begin(), a->end(), b->begin(), b->end(), std::back_inserter(ret));
+    return std::make_shared<const std::vector<symbol>>(std::move(ret));
+}
+
+void component::refresh() const {
+    static const name_set no_names = std::make_shared<const std::vector<symbol>>();
+    bool names = !_cached;
+    bool defined = _undefined &&
+        (_undefined_mixed || (_undefined_in != nullptr && _defined_at != _undefined_in->definitions()));
+    if(!names && !defined)
+        return;
+    if(is_expr()) {
+        expr_head().refresh();
+        expr_tail().refresh();
+        if(names) {
+            _free = merge_names(expr_head()._free, expr_tail()._free);
+            _names = merge_names(expr_head()._names, expr_tail()._names);
+            _size = 1 + expr_head()._size + expr_tail()._size;
+        }
+        _undefined = expr_head()._undefined || expr_tail()._undefined;
+        watch_undefined(expr_head(), expr_tail());
+    } else if (is_lambda()) {
+        lambda_out().refresh();
+        symbol arg = lambda_arg().id_symbol();
+        if(names) {
+            const std::vector<symbol>& body = *lambda_out()._free;
+            std::vector<symbol>::const_iterator pos = std::lower_bound(body.begin(), body.end(), arg);
+            if(pos == body.end() || *pos != arg) {
+                _free = lambda_out()._free;
+            } else {
+                std::vector<symbol> free = body;
+                free.erase(free.begin() + (pos - body.begin()));
+                _free = free.empty() ? no_names : std::make_shared<const std::vector<symbol>>(std::move(free));
+            }
+            _names = merge_names(lambda_out()._names, std::make_shared<const std::vector<symbol>>(1, arg));
+            _size = 2 + lambda_out()._size;
+        }
+        _undefined = lambda_out()._undefined;
+        watch_undefined(lambda_out(), lambda_out());
+    } else if (is_id()) {
+        if(scope() == &prepkg::bound) {
+            if(names) {
+                _free = std::make_shared<const std::vector<symbol>>(1, id_symbol());
+                _names = _free;
+                _size = 1;
+            }
+            _undefined = false;
+            _undefined_in = nullptr;
+        } else {
+            if(names) {
+                _free = no_names;
+                _names = no_names;
+                _size = 1;
+            }
+            _undefined = id_value() == nullptr;
+            const global_package * ctx = _undefined ? _scope->context() : nullptr;
+            _undefined_in = ctx != nullptr && !ctx->is_sealed() ? ctx : nullptr;
+        }
+        _undefined_mixed = false;
+    } else {
+        throw std::logic_error("component not a lambda, expression, or identifier");
+    }
+    _cached = true;
+    _defined_at = _undefined_in != nullptr ? _undefined_in->definitions() : 0;
+}
+
 bool component::has_unknown() const {
-    std::vector<std::string> known;
-    return has_unknown(known);
+    refresh();
+    return !_free->empty() || _undefined;
 }
 
-bool component::has_unknown(std::vector<std::string>& known) const {
+bool component::has_unknown(std::vector<symbol>& known) const {
     if(is_expr()) {
         return expr_head().has_unknown(known) || expr_tail().has_unknown(known);
     } else if (is_lambda()) {
-        known.push_back(lambda_arg().id_name());
+        known.push_back(lambda_arg().id_symbol());
         bool has = lambda_out().has_unknown(known);
         known.pop_back();
         return has;
     } else if (is_id()) {
         if(scope() == &prepkg::bound) {
-            if (std::find(known.begin(), known.end(), id_name()) == known.end()) { // not in the input list
+            if (std::find(known.begin(), known.end(), id_symbol()) == known.end()) { // not in the input list
                 return 1;
             } else { // is in the input list
                 return 0;
             }
-        } else if (scope() == &prepkg::global) {
-            const component * value = global.get_value(id_name());
-            if (value != nullptr) {
-                return 0;
-            } else {
-                return 1;
-            }
         } else {
-            const component * value = scope()->get_value(id_name());
-            if (value != nullptr) {
-                return 0;
-            } else {
-                return 1;
-            }
+            return id_value() == nullptr;
         }
     } else {
         throw std::logic_error("cannot call has_unknown on componenent of indeterminate type");
@@ -165,18 +527,18 @@ bool component::has_unknown(std::vector<std::string>& known) const {
 
 bool component::lambda_unknown_before_arg() const {
     assert(is_lambda());
-    return lambda_out().bound_above_below(lambda_arg().id_name()) && lambda_out().lambda_unknown_before_arg(lambda_arg().id_name()) != 2;
+    return lambda_out().bound_above_below(lambda_arg().id_symbol()) && lambda_out().lambda_unknown_before_arg(lambda_arg().id_symbol()) != 2;
 }
 
-int component::lambda_unknown_before_arg(const std::string& argname) const {
+int component::lambda_unknown_before_arg(symbol argname) const {
     if (is_id()) {
-        if(id_name() == argname)
+        if(id_symbol() == argname)
             return 2;
         if(has_unknown())
             return 1;
         return 0;
     } else if (is_lambda()) {
-        if(lambda_arg().id_name() == argname)
+        if(lambda_arg().id_symbol() == argname)
             return 0;
         return lambda_out().lambda_unknown_before_arg(argname);
     } else if (is_expr()) {
@@ -203,24 +565,12 @@ int component::evaluate_step() {
     } else if (is_lambda()) {
         return lambda_out().evaluate_step();
     } else if (is_id()) {
-        if(scope() == &prepkg::bound) {
-            return 0;
-        } else if (scope() == &prepkg::global) {
-            const component * value = global.get_value(id_name());
-            if (value != nullptr) {
-                copy_preserve_parent(*value);
-                return 1;
-            } else {
-                return 0;
-            }
+        const component * value = id_value();
+        if (value != nullptr) {
+            expand(*this, *value);
+            return 1;
         } else {
-            const component * value = scope()->get_value(id_name());
-            if (value != nullptr) {
-                copy_preserve_parent(*value);
-                return 1;
-            } else {
-                return 0;
-            }
+            return 0;
         }
     } else {
         throw std::logic_error("cannot evaluate uninitialized expression");
@@ -241,173 +591,211 @@ std::vector<component*> component::find_steps() {
         std::vector<component*> temp = lambda_out().find_steps();
         ret.insert(ret.end(), temp.begin(), temp.end());
     } else if (is_id()) {
-        if(scope() == &prepkg::global) {
-            if(global.get_value(id_name()) != nullptr)
-                ret.push_back(this);            
-        } else if (scope() != &prepkg::bound) {
-            if(scope()->get_value(id_name()) != nullptr)
-                ret.push_back(this);
-        }
+        if(id_value() != nullptr)
+            ret.push_back(this);
     } else {
         throw std::logic_error("cannot evaluate unitialized expression");
     }
     return ret;
 }
 
-bool component::match_bound(std::string myid, const component& comp, std::string compid) const {
-    if(is_lambda()) {
-        if(!comp.is_lambda()) {
+/**
+ * the lambdas binding each name on the way down a term, so the binder of a variable is found in constant time
+ * however deep the term is
+ **/
+class binder_depths {
+private:
+    std::unordered_map<symbol, std::vector<unsigned>> depths;
+    unsigned depth = 0;
+public:
+    void enter(symbol name) { depths[name].push_back(depth++); }
+    void leave(symbol name) { depths[name].pop_back(); --depth; }
+    /**how many lambdas out the binder of `name` is, counting from 1, or 0 if it is free**/
+    unsigned index(symbol name) const {
+        std::unordered_map<symbol, std::vector<unsigned>>::const_iterator it = depths.find(name);
+        if(it == depths.end() || it->second.empty())
+            return 0;
+        return depth - it->second.back();
+    }
+};
+
+static bool alpha_equal(const component& a, binder_depths& in_a, const component& b, binder_depths& in_b) {
+    if(a.is_lambda()) {
+        if(!b.is_lambda())
             return false;
-        }
-        if(lambda_arg().id_name() == myid) {
-            if(comp.lambda_out().bound_from_above(compid))
-                return false;
-            else
-                return true;
-        }
-        if(comp.lambda_arg().id_name() == compid) {
-            if(lambda_out().bound_from_above(myid))
-                return false;
-            else
-                return true;
-        }
-        return lambda_out().match_bound(myid, comp.lambda_out(), compid);
-    } else if (is_expr()) {
-        if(!comp.is_expr()) {
+        in_a.enter(a.lambda_arg().id_symbol());
+        in_b.enter(b.lambda_arg().id_symbol());
+        bool ret = alpha_equal(a.lambda_out(), in_a, b.lambda_out(), in_b);
+        in_a.leave(a.lambda_arg().id_symbol());
+        in_b.leave(b.lambda_arg().id_symbol());
+        return ret;
+    } else if(a.is_expr()) {
+        if(!b.is_expr())
             return false;
-        }
-        return expr_head().match_bound(myid,comp.expr_head(),compid) && expr_tail().match_bound(myid,comp.expr_tail(),compid);
-    } else if (is_id()) {
-        if(!comp.is_id()) {
+        return alpha_equal(a.expr_head(), in_a, b.expr_head(), in_b) && alpha_equal(a.expr_tail(), in_a, b.expr_tail(), in_b);
+    } else if(a.is_id()) {
+        if(!b.is_id() || a.scope() != b.scope())
             return false;
-        }
-        return true;
-    } else {
-        return false;
+        if(a.scope() != &prepkg::bound)
+            return a.id_symbol() == b.id_symbol();
+        unsigned index = in_a.index(a.id_symbol());
+        if(index != in_b.index(b.id_symbol()))
+            return false;
+        return index != 0 || a.id_symbol() == b.id_symbol(); //free variables only match by name
     }
+    throw std::logic_error("component not a lambda, expression, or identifier");
 }
 
-bool component::lambda_arg_match(const component& comp) const {
-    assert(is_lambda());
-    if(!comp.is_lambda()) {
-        return false;
+bool component::compare(const component& comp) const {
+    if(this == &comp)
+        return true;
+    binder_depths mine, theirs;
+    return alpha_equal(*this, mine, comp, theirs);
+}
+
+static size_t mix_hash(size_t h, size_t word) {
+    h ^= word + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+static size_t alpha_hash(const component& in, binder_depths& depths) {
+    if(in.is_lambda()) {
+        depths.enter(in.lambda_arg().id_symbol());
+        size_t ret = mix_hash(1, alpha_hash(in.lambda_out(), depths));
+        depths.leave(in.lambda_arg().id_symbol());
+        return ret;
+    } else if(in.is_expr()) {
+        return mix_hash(mix_hash(2, alpha_hash(in.expr_head(), depths)), alpha_hash(in.expr_tail(), depths));
+    } else if(in.is_id()) {
+        unsigned index = in.scope() == &prepkg::bound ? depths.index(in.id_symbol()) : 0;
+        if(index != 0)
+            return mix_hash(3, index);
+        return mix_hash(mix_hash(4, in.id_symbol()), std::hash<const package*>()(in.scope()));
     }
-    return match_bound(lambda_arg().id_name(), comp, comp.lambda_arg().id_name());
+    throw std::logic_error("component not a lambda, expression, or identifier");
 }
 
-bool component::compare(const component& comp) const {
-    if(is_lambda()) {
-        if(!comp.is_lambda()) {
-            return false;
+size_t component::alpha_hash() const {
+    binder_depths depths;
+    return lambda::alpha_hash(*this, depths);
+}
+
+/**
+ * appends how an identifier is written. names longer than one character (or L, which would start a lambda) are
+ * written with a backquote. the space that would end such a name is never written: the output has always been
+ * printed without it, and results are compared against saved output
+ **/
+static void write_name(std::string& out, const std::string& name) {
+#ifndef NDEBUG
+    bool prime = false;
+    for(size_t i = 0; i < name.size(); ++i) {
+        assert(!is_name_break(name.at(i)));
+        assert(name.at(i) >= '!');//not a control character or space
+        assert(name.at(i) <= '~');//not DEL or extended ascii
+        if(name.at(i) == '\'')
+            prime = true;
+        if(prime)
+            assert(name.at(i) == '\'');
+    }
+#endif
+    switch(component::base_name(name).size()) {
+    case 0:
+        throw std::logic_error("identifier has name of length 0");
+    case 1:
+        if(name.at(0) != 'L') {
+            out += name;
+            break;
         }
-        if(lambda_arg_match(comp)) {
-            return lambda_out().compare(comp.lambda_out());
+        //else fallthrough
+    default:
+        if(name.at(name.size() - 1) == '\'' && name.at(1) == '\'' && name.at(0) != 'L') {
+            out += name;
         } else {
-            return false;
-        }
-    } else if (is_expr()) {
-        if(!comp.is_expr()) {
-            return false;
-        }
-        return expr_head().compare(comp.expr_head()) && expr_tail().compare(comp.expr_tail());
-    } else if (is_id()) {
-        if(!comp.is_id()) {
-            return false;
-        }
-        if(scope() != &prepkg::bound || comp.scope() != &prepkg::bound) {
-            if(scope() != comp.scope() || id_name() != comp.id_name())
-                return false;
-            else
-                return true;
-        } else { //let the lambda section determine how to interpret bound ids
-            return true;
+            out += '`';
+            out += name;
         }
+        break;
     }
 }
 
-std::string component::to_string() const {
-    std::string ret = "";
-
-    if (is_lambda()) {
-        const component * node = this;
-        ret += "L";
-        assert(lambda_arg().is_id());
-        ret += lambda_arg().to_string();
-        node = &lambda_out();
+/**
+ * text written to a stream is passed on in pieces of about this size, so the whole term is never held at once
+ **/
+static const size_t write_chunk = 1 << 14;
+
+/**
+ * writes `in` to `out` in a single pass. if `stream` is given, `out` is emptied into it whenever it grows past
+ * write_chunk. if `steps` is given, a span is added to `spans` for every node of `in` found in it, and the node
+ * is removed from `steps`
+ **/
+static void write_term(const component& in, std::string& out, std::ostream * stream,
+        std::unordered_set<const component*> * steps, std::vector<step_string_info> * spans) {
+    if(stream != nullptr && out.size() >= write_chunk) {
+        stream->write(out.data(), out.size());
+        out.clear();
+    }
+    size_t span = 0;
+    if(steps != nullptr && !in.is_lambda()) {
+        if(steps->erase(&in) != 0) {
+            span = spans->size() + 1;
+            spans->push_back(step_string_info{const_cast<component*>(&in), int(out.size()), int(out.size()), 0});
+        }
+    }
+    if(in.is_lambda()) {
+        const component * node = &in;
+        out += 'L';
         while(node->is_lambda()) {
             assert(node->lambda_arg().is_id());
-            ret += node->lambda_arg().to_string();
+            write_name(out, node->lambda_arg().id_name());
             node = &node->lambda_out();
         }
-        ret += ".";
+        out += '.';
         assert(node->is_init());
-        ret += node->to_string();
-    } else if (is_expr()) {
-        if(expr_head().is_lambda()) {
-            ret += "(";
-            ret += expr_head().to_string();
-            ret += ")";
+        write_term(*node, out, stream, steps, spans);
+    } else if(in.is_expr()) {
+        const component& head = in.expr_head();
+        if(head.is_lambda()) {
+            out += '(';
+            write_term(head, out, stream, steps, spans);
+            out += ')';
         } else {
-            ret += expr_head().to_string();
+            write_term(head, out, stream, steps, spans);
         }
-        if(expr_tail().is_lambda() || expr_tail().is_expr()) {
-            ret += "(";
-            ret += expr_tail().to_string();
-            ret += ")";
+        if(span != 0)
+            (*spans)[span - 1].middle = out.size();
+        const component& tail = in.expr_tail();
+        if(tail.is_lambda() || tail.is_expr()) {
+            out += '(';
+            write_term(tail, out, stream, steps, spans);
+            out += ')';
         } else {
-            ret += expr_tail().to_string();
-        }
-    } else if (is_id()) {
-#ifndef NDEBUG
-        bool prime = false;
-        for(size_t i = 0; i < id_name().size(); ++i) {
-            assert(!is_name_break(id_name().at(i)));
-            assert(id_name().at(i) >= '!');//not a control character or space
-            assert(id_name().at(i) <= '~');//not DEL or extended ascii
-            if(id_name().at(i) == '\'')
-                prime = true;
-            if(prime)
-                assert(id_name().at(i) == '\'');
-        }
-#endif
-        switch(base_name(id_name()).size()) {
-        case 0:
-            throw std::logic_error("identifier has name of length 0");
-        case 1:
-            if(id_name().at(0) != 'L') {
-                ret += id_name();
-                break;
-            }
-            //else fallthrough
-        default:
-            if(id_name().at(id_name().size() - 1) == '\'') {
-                if(id_name().at(1) == '\'' && id_name().at(0) != 'L') {
-                    ret += id_name();
-                } else {
-                    ret += "`";
-                    ret += id_name();
-                }
-            } else {
-                ret += "`";
-                ret += id_name();
-                ret += " ";
-            }
-            break;
+            write_term(tail, out, stream, steps, spans);
         }
+    } else if(in.is_id()) {
+        write_name(out, in.id_name());
     } else {
         throw std::logic_error("component not a lambda, expression, or identifier");
     }
+    if(span != 0)
+        (*spans)[span - 1].end = out.size();
+}
 
+std::string component::to_string() const {
+    std::string ret;
+    ret.reserve(size());
+    write_term(*this, ret, nullptr, nullptr, nullptr);
+    return ret;
+}
 
-    for(size_t i = 0; i < ret.size();) {
-        if(ret.at(i) == ' ' && ((i + 1) < ret.size() ? is_name_break(ret.at(i + 1)) : 1)) {
-            ret.erase(i, 1);
-        } else {
-            ++i;
-        }
-    }
+void component::write(std::string& out) const {
+    write_term(*this, out, nullptr, nullptr, nullptr);
+}
 
-    return ret;
+void component::write(std::ostream& out) const {
+    std::string buffer;
+    buffer.reserve(write_chunk * 2);
+    write_term(*this, buffer, &out, nullptr, nullptr);
+    out.write(buffer.data(), buffer.size());
 }
 
 std::pair<std::string, std::vector<step_string_info>> component::step_string(const std::vector<component*>& steps) const {
@@ -419,139 +807,139 @@ std::pair<std::string, std::vector<step_string_info>> component::step_string(con
 
 std::vector<step_string_info> component::step_string(std::string& out, std::vector<component*>& steps) const {
     std::vector<step_string_info> ret;
+    std::unordered_set<const component*> left(steps.begin(), steps.end());
+    write_term(*this, out, nullptr, &left, &ret);
+    steps.erase(std::remove_if(steps.begin(), steps.end(), [&left](const component * step) {
+        return left.count(step) == 0;
+    }), steps.end());
+    return ret;
+}
 
-    if (is_lambda()) {
-        const component * node = this;
-        out += "L";
-        assert(lambda_arg().is_id());
-        out += lambda_arg().to_string();
-        node = &lambda_out();
-        while(node->is_lambda()) {
-            assert(node->lambda_arg().is_id());
-            node->lambda_arg().step_string(out, steps);
-            node = &node->lambda_out();
-        }
-        out += ".";
-        assert(node->is_init());
-        node->step_string(out, steps);
-    } else if (is_expr()) {
-        std::vector<component*>::iterator pos = std::find(steps.begin(), steps.end(), this);
-
-        if(pos != steps.end()) {
-            step_string_info to_add;
-            to_add.pos = *pos;
-            steps.erase(pos);
-            to_add.begin = out.size();
-            if(expr_head().is_lambda()) {
-                out += "(";
-                std::vector<step_string_info> subret = expr_head().step_string(out, steps);
-                out += ")";
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            } else {
-                std::vector<step_string_info> subret = expr_head().step_string(out, steps);
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            }
-            to_add.middle = out.size();
-            if(expr_tail().is_lambda() || expr_tail().is_expr()) {
-                out += "(";
-                std::vector<step_string_info> subret = expr_tail().step_string(out, steps);
-                out += ")";
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            } else {
-                std::vector<step_string_info> subret = expr_tail().step_string(out, steps);
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            }
-            to_add.end = out.size();
-        } else {
-            if(expr_head().is_lambda()) {
-                out += "(";
-                std::vector<step_string_info> subret = expr_head().step_string(out, steps);
-                out += ")";
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            } else {
-                std::vector<step_string_info> subret = expr_head().step_string(out, steps);
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            }
-            if(expr_tail().is_lambda() || expr_tail().is_expr()) {
-                out += "(";
-                std::vector<step_string_info> subret = expr_tail().step_string(out, steps);
-                out += ")";
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            } else {
-                std::vector<step_string_info> subret = expr_tail().step_string(out, steps);
-                ret.insert(ret.end(), subret.begin(), subret.end());
-            }
-        }
-    } else if (is_id()) {
-        std::vector<component*>::iterator pos = std::find(steps.begin(), steps.end(), this);
-        step_string_info to_add;
-        if(pos != steps.end()) {
-            to_add.pos = *pos;
-            to_add.begin = out.size();
-            to_add.middle = out.size();
-        }
-        switch(base_name(id_name()).size()) {
-        case 0:
-            throw std::logic_error("identifier has name of length 0");
-        case 1:
-            if(id_name().at(0) != 'L') {
-                out += id_name();
-                break;
-            }
-            //else fallthrough
-        default:
-            if(id_name().at(id_name().size() - 1) == '\'') {
-                if(id_name().at(1) == '\'' && id_name().at(0) != 'L') {
-                    out += id_name();
-                } else {
-                    out += "`";
-                    out += id_name();
-                }
-            } else {
-                out += "`";
-                out += id_name();
-                out += " ";
-            }
-            break;
-        }
-        if(pos != steps.end()) {
-            to_add.end = out.size();
-            steps.erase(pos);
-        }
-    } else {
-        throw std::logic_error("component not a lambda, expression, or identifier");
+void package::decode(symbol key) const {
+    if(pending.empty())
+        return;
+    std::unordered_map<symbol, decoder>::iterator it = pending.find(key);
+    if(it == pending.end())
+        return;
+    component& value = values[symbols.name(key)];
+    value = it->second();
+    slots[key].value = &value;
+    pending.erase(it);
+}
+
+const component * package::get_value(const std::string& key) const {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(!pending.empty())
+            decode(symbols.intern(key));
+        std::map<std::string, component>::const_iterator it = values.find(key);
+        if(it != values.end())
+            return &it->second;
     }
+    return fallback != nullptr ? fallback->get_value(key) : nullptr;
+}
 
-    for(size_t i = 0; i < out.size();) {
-        if(out.at(i) == ' ' && ((i + 1) < out.size() ? is_name_break(out.at(i + 1)) : 1)) {
-            for(step_string_info& ssi : ret) {
-                if(ssi.begin > i)
-                    --ssi.begin;
-                if(ssi.middle > i)
-                    --ssi.middle;
-                if(ssi.end > i)
-                    --ssi.end;
-            }
-            out.erase(i, 1);
-        } else {
-            ++i;
-        }
+const component * package::get_value(symbol key) const {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        decode(key);
+        std::unordered_map<symbol, definition_slot>::const_iterator it = slots.find(key);
+        if(it != slots.end() && it->second.value != nullptr)
+            return it->second.value;
     }
+    return fallback != nullptr ? fallback->get_value(key) : nullptr;
 }
 
+definition_slot * package::slot(symbol key) {
+    std::lock_guard<std::mutex> guard(lock);
+    decode(key);
+    std::unordered_map<symbol, definition_slot>::iterator it = slots.find(key);
+    if(it != slots.end())
+        return &it->second;
+    definition_slot * ret = &slots[key];
+    //until the name is given a value of its own, it reads the prelude's, which never changes
+    if(fallback != nullptr)
+        ret->value = fallback->get_value(key);
+    return ret;
+}
 
-const component * package::get_value(std::string key) const {
-    try { //holding out for c++20 map::contains
-        return &values.at(key);
-    } catch(std::out_of_range) {
-        return nullptr;
+void package::add_value(std::string key, const component& to_add) {
+    if(owner != nullptr && owner->sealed)
+        throw std::logic_error("cannot add values to the prelude of another context");
+    symbol sym = symbols.intern(key);
+    //a name visible elsewhere in the context can change meaning too, if this package is looked in first
+    bool redefines = owner != nullptr && owner->get_value(sym) != nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(pending.erase(sym) != 0 || slots[sym].value != nullptr)
+            redefines = true;
+        component& value = values[key];
+        value = to_add;
+        slots[sym].value = &value;
+    }
+    if(owner != nullptr) {
+        owner->changed(redefines);
+        owner->refresh(sym);
     }
 }
-void package::add_value(std::string key, const component& to_add) {
-    values[key] = to_add;
+
+void package::add_lazy_value(std::string key, decoder make) {
+    if(owner != nullptr && owner->sealed)
+        throw std::logic_error("cannot add values to the prelude of another context");
+    symbol sym = symbols.intern(key);
+    bool redefines;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        redefines = values.erase(key) != 0 || pending.count(sym) != 0;
+        slots[sym].value = nullptr;
+        pending[sym] = std::move(make);
+    }
+    if(owner != nullptr) {
+        owner->changed(redefines);
+        owner->refresh(sym);
+    }
+}
+
+void package::for_each_value(const std::function<void(const std::string&, const component&)>& each) const {
+    std::vector<std::pair<std::string, const component*>> all;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        while(!pending.empty())
+            decode(pending.begin()->first);
+        for(const std::pair<const std::string, component>& value : values)
+            all.push_back(std::make_pair(value.first, &value.second));
+    }
+    for(const std::pair<std::string, const component*>& value : all)
+        each(value.first, *value.second);
+}
+
+global_package::global_package() : scope(&own_scope), defined_at(++generation_clock), redefined_at(++generation_clock) {
+    base.owner = this;
+    own_scope.owner = this;
+}
+
+global_package::global_package(package * scope)
+        : scope(scope), defined_at(++generation_clock), redefined_at(++generation_clock) {
+    base.owner = this;
+    scope->owner = this;
+}
+
+global_package::global_package(std::shared_ptr<global_package> prelude) : global_package() {
+    prelude->sealed = true;
+    this->prelude = std::move(prelude);
+}
+
+void global_package::changed(bool redefines) {
+    if(redefines)
+        redefined_at = ++generation_clock;
+    defined_at = ++generation_clock;
 }
 
 const component * global_package::get_value(std::string key) const {
+    return get_value(symbols.intern(key));
+}
+
+const component * global_package::get_value(symbol key) const {
     const component * ret = base.get_value(key);
     if (ret == nullptr) {
         for(const std::pair<const std::string,package>& p : packages) {
@@ -560,12 +948,34 @@ const component * global_package::get_value(std::string key) const {
                 return ret;
             }
         }
-        return nullptr;
+        return prelude ? prelude->get_value(key) : nullptr;
     } else {
         return ret;
     }
 }
 
+definition_slot * global_package::global_slot(symbol key) {
+    std::unordered_map<symbol, definition_slot>::iterator it = globals.find(key);
+    if(it != globals.end())
+        return &it->second;
+    definition_slot * ret = &globals[key];
+    ret->value = get_value(key);
+    return ret;
+}
+
+definition_slot * global_package::find_slot(package * scope, symbol key) {
+    std::lock_guard<std::mutex> guard(slot_lock);
+    if(scope == this->scope)
+        return global_slot(key);
+    return scope->slot(key);
+}
+
+void global_package::refresh(symbol key) {
+    std::unordered_map<symbol, definition_slot>::iterator it = globals.find(key);
+    if(it != globals.end())
+        it->second.value = get_value(key);
+}
+
 const component * global_package::get_value(std::string component_key, std::vector<std::string> package_keys) const {
     const component * ret;
     for(std::vector<std::string>::const_reverse_iterator pki = package_keys.crbegin(); pki != package_keys.crend(); ++pki) {
@@ -586,7 +996,7 @@ const component * global_package::get_value(std::string component_key, std::vect
                 return ret;
             }
         }
-        return nullptr;
+        return prelude ? prelude->get_value(component_key) : nullptr;
     } else {
         return ret;
     }
@@ -600,27 +1010,32 @@ void global_package::add_value(std::string key, const component& to_add) {
 package * global_package::add_package(std::string key) {
     if(key == "global")
         return &base;
-    return &packages[key];
+    std::map<std::string, package>::iterator it = packages.find(key);
+    if(it != packages.end())
+        return &it->second;
+    package * ret = &packages[key];
+    ret->owner = this;
+    if(prelude)
+        ret->fallback = static_cast<const global_package&>(*prelude).get_package(key);
+    return ret;
 }
 
 const package * global_package::get_package(std::string key) const {
     if(key == "global")
         return &base;
-    try {
-        return &packages.at(key);
-    } catch (std::out_of_range) {
-        return nullptr;
-    }
+    std::map<std::string, package>::const_iterator it = packages.find(key);
+    if(it != packages.end())
+        return &it->second;
+    return prelude ? static_cast<const global_package&>(*prelude).get_package(key) : nullptr;
 }
 
 package * global_package::get_package(std::string key) {
     if(key == "global")
         return &base;
-    try {
-        return &packages.at(key);
-    } catch (std::out_of_range) {
-        return nullptr;
-    }
+    std::map<std::string, package>::iterator it = packages.find(key);
+    if(it != packages.end())
+        return &it->second;
+    return prelude ? prelude->get_package(key) : nullptr;
 }
 
 }
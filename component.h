@@ -5,13 +5,49 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "nullable.h"
+#include "symbol.h"
+#include "pool.h"
 #include <limits>
+#include <stdexcept>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <ostream>
 
 namespace lambda {
 
 class package;
 class component;
+class global_package;
+class normal_form_cache;
+class church_natives;
+class trace_sink;
+class definition_profiler;
+struct profile_frame;
+
+/**
+ * the order component::evaluate looks for the next step of a term in
+ **/
+enum class reduction_strategy {
+    normal_order,   //leftmost outermost, skipping arguments that might not be used
+    applicative,    //every argument is reduced before it is substituted
+    weak_head,      //stops at a lambda, or an application with no redex at its head
+    head_normal,    //like weak_head, but also reduces under lambdas
+    closed_by_value //normal order, except that closed arguments are reduced before they are substituted
+};
+
+/**
+ * where an identifier finds its value. a slot is made once per name and package and never moves, so
+ * identifiers keep a pointer to it, and a redefinition is seen through the same slot
+ **/
+struct definition_slot {
+    /**null while the name has no value**/
+    const component * value = nullptr;
+};
 
 /**
  * Stores values of idenitifiers in `packages`. Identifiers that belong to a specific package
@@ -20,20 +56,104 @@ class component;
  * Special packages are dummies that indicate a more general attribute (namely global, bound, lambda, expr)
  **/
 class package {
+public:
+    /**makes the value of a definition whose body has not been built yet, see add_lazy_value()**/
+    typedef std::function<component()> decoder;
 private:
-    std::map<std::string, component> values;
+    //lookups build pending values, which may happen from several threads when the package is in a prelude
+    mutable std::map<std::string, component> values;
+    mutable std::unordered_map<symbol, definition_slot> slots;
+    mutable std::unordered_map<symbol, decoder> pending;
+    mutable std::mutex lock;
+    global_package * owner = nullptr;
+    /**the package of the same name in the prelude of `owner`, where names this package has no value for are found**/
+    const package * fallback = nullptr;
+    friend class global_package;
+
+    /**moves `key` from pending to values if it is there. `lock` must be held**/
+    void decode(symbol key) const;
 public:
-    const component * get_value(std::string key) const;
+    const component * get_value(const std::string& key) const;
+    const component * get_value(symbol key) const;
     void add_value(std::string key, const component& to_add);
+    /**
+     * adds a value that is only built by `make` the first time it is looked up, as values of a prelude image
+     * are, so names that are never used cost nothing
+     **/
+    void add_lazy_value(std::string key, decoder make);
+    /**
+     * calls `each` with every value of the package, building any that are still pending. values only found in
+     * the fallback are not included
+     **/
+    void for_each_value(const std::function<void(const std::string&, const component&)>& each) const;
+    /**the slot for `key` in this package, made empty if the name has no value yet**/
+    definition_slot * slot(symbol key);
+    /**the context this package belongs to. null for the special packages other than prepkg::global**/
+    global_package * context() const { return owner; }
 };
 
 /**
- * Containes dummy packages with special meanings
+ * where the generations of every context are drawn from, see global_package::definitions(). a new generation is
+ * always larger than any seen before, and no two contexts ever have the same one, so something cached for one
+ * context is never taken as current for another
+ **/
+inline std::atomic<unsigned> generation_clock{1};
+
+/**
+ * counts of the work done on components by one thread. they only ever go up, except `live`, so the work done
+ * by something is the difference between the counts before and after it, as in load_file
+ **/
+struct work_counters {
+    /**contractions by component::evaluate_expression**/
+    long beta = 0;
+    /**identifiers replaced by their value**/
+    long delta = 0;
+    /**lambda arguments renamed to avoid capture during a contraction**/
+    long renames = 0;
+    /**components constructed and destroyed**/
+    long allocated = 0;
+    long freed = 0;
+    /**bytes of nodes deep-copied by component::copy**/
+    long copied_bytes = 0;
+    /**components live now, and the most live at once since `peak` was last set to `live`**/
+    long live = 0;
+    long peak = 0;
+};
+
+/**the counters of the calling thread**/
+inline thread_local work_counters counters;
+
+/**a copy of `counters` to count from with counted_since(), starting a new peak**/
+inline work_counters snapshot_counters() {
+    counters.peak = counters.live;
+    return counters;
+}
+
+/**the work counted since `snapshot`. `live` and `peak` are how far the live count is and got above it then**/
+inline work_counters counted_since(const work_counters& snapshot) {
+    work_counters ret;
+    ret.beta = counters.beta - snapshot.beta;
+    ret.delta = counters.delta - snapshot.delta;
+    ret.renames = counters.renames - snapshot.renames;
+    ret.allocated = counters.allocated - snapshot.allocated;
+    ret.freed = counters.freed - snapshot.freed;
+    ret.copied_bytes = counters.copied_bytes - snapshot.copied_bytes;
+    ret.live = counters.live - snapshot.live;
+    ret.peak = counters.peak - snapshot.live;
+    return ret;
+}
+
+/**
+ * Containes dummy packages with special meanings. they never hold values and are only compared by address,
+ * so they are shared by every context
  **/
 namespace prepkg {
     /**Indicates an identifier that corresponds to an argument to a lambda**/
     inline package bound;
-    /**Indicates an identifier that does not belong to a specific package, but rather is globally accessable**/
+    /**
+     * Indicates an identifier that does not belong to a specific package, but rather is globally accessable.
+     * used by the context `global`; other contexts have their own, see global_package::global_scope()
+     **/
     inline package global;
     /**Indicates a component that is a lambda expression. See component::lambda()**/
     inline package lambda;
@@ -42,27 +162,80 @@ namespace prepkg {
 }
 
 /**
- * stores all identifiers and their values in a program
- * 
- * class intended to be used as a singleton
+ * stores all identifiers and their values in a program, and is the context its statements are evaluated in.
+ *
+ * identifiers find their context through their scope: global identifiers are scoped to global_scope() and
+ * the rest to a package the context owns, so evaluating a component needs no other handle on it. separate
+ * contexts share nothing that evaluation writes to, and can be used from different threads at once.
+ *
+ * a context can be made on top of a prelude, a context that is finished being loaded. names and packages
+ * the context does not have are looked up in the prelude. opening a prelude package with add_package makes an
+ * empty package of the same name that looks in the prelude's for any name it has no value of its own for, so
+ * values are only ever added to the context, the prelude is never written to, and it can be shared
  **/
 class global_package {
 private:
     package base;
+    /**global_scope() of contexts other than `global`**/
+    package own_scope;
+    package * scope;
+    std::shared_ptr<global_package> prelude;
     std::map<std::string, package> packages;
     std::vector<std::string> open;
+    /**slots of identifiers in the global scope, holding whatever get_value would find for them**/
+    std::unordered_map<symbol, definition_slot> globals;
+    /**guards making slots, which identifiers do lazily, possibly from several threads**/
+    std::mutex slot_lock;
+    std::atomic<unsigned> defined_at;
+    std::atomic<unsigned> redefined_at;
+    /**set once this is the prelude of another context, after which nothing may be added to it**/
+    bool sealed = false;
+
+    friend class package;
+    friend class image_writer;
+    void refresh(symbol key);
+    /**moves the context to a new generation after a value is added to one of its packages**/
+    void changed(bool redefines);
 public:
+    global_package();
+    /**a context whose global identifiers are scoped to `scope`, which is how `global` uses prepkg::global**/
+    explicit global_package(package * scope);
+    /**a context that falls back on `prelude`, which is sealed: it must not be loaded into any more**/
+    explicit global_package(std::shared_ptr<global_package> prelude);
+    global_package(const global_package&) = delete;
+
+    /**the scope of identifiers that are not in a package**/
+    package * global_scope() const { return scope; }
+    /**
+     * changes every time a value is added to a package of the context, so cached lookups of identifier values
+     * can tell that they are out of date. drawn from generation_clock
+     **/
+    unsigned definitions() const { return defined_at.load(std::memory_order_relaxed); }
+    /**
+     * changes when a value is added under a name that already had one, which can change what terms that were
+     * already reduced mean. see normal_form_cache
+     **/
+    unsigned redefinitions() const { return redefined_at.load(std::memory_order_relaxed); }
+    /**whether the context is the prelude of another, so its values will never change**/
+    bool is_sealed() const { return sealed; }
+    /**opens package `key` for adding values, copying it from the prelude if only the prelude has it**/
     package * add_package(std::string key);
+    /**a package of this context, or failing that of the prelude. only packages from add_package may be added to**/
     package * get_package(std::string key);
     const package * get_package(std::string key) const;
 
     const component * get_value(std::string key) const;
+    const component * get_value(symbol key) const;
     const component * get_value(std::string component_key, std::vector<std::string> package_keys) const;
     void add_value(std::string key, const component& to_add);
+    /**the slot an identifier in the global scope reads its value from, kept up to date as values are added**/
+    definition_slot * global_slot(symbol key);
+    /**the slot an identifier with scope `scope` reads its value from. safe to call from several threads**/
+    definition_slot * find_slot(package * scope, symbol key);
 };
 
-/**singleton used by components**/
-inline global_package global;
+/**the context used when no other is given**/
+inline global_package global(&prepkg::global);
 
 struct step_string_info {
     component * pos;
@@ -79,58 +252,151 @@ private:
     component* _parent;
     package* _scope;
     
-    nullable<std::string> _name;
+    symbol _name;
+    /**where an identifier's value is, found on first use. null for anything else**/
+    mutable definition_slot * _slot;
+    /**the definition this node was expanded from, if it was tagged with one. see definition_profiler**/
+    const profile_frame * _origin;
 
     nullable<component> _head;
     nullable<component> _tail;
 
+    typedef std::shared_ptr<const std::vector<symbol>> name_set;
+
+    /**
+     * summary of the subtree, computed on demand by refresh(). `_free` holds the sorted symbols of bound
+     * identifiers not bound inside the subtree, `_names` every bound identifier or lambda argument symbol used
+     * in it, `_size` the number of nodes, and `_undefined` whether some non-bound identifier has no value.
+     *
+     * identifiers never lose their values, so only an undefined subtree can change without being touched, and
+     * only by a definition in the context of one of its undefined identifiers. `_undefined_in` is that context
+     * as of its generation `_defined_at`, or null if every such context is sealed. `_undefined_mixed` is set
+     * if there is more than one, and the subtree is then checked every time.
+     *
+     * `_cached` is cleared on this node and all of its ancestors whenever the subtree changes. a node that is
+     * not cached never has a cached ancestor, so invalidation can stop at the first node already cleared
+     **/
+    mutable bool _cached;
+    mutable bool _undefined;
+    mutable bool _undefined_mixed;
+    mutable const global_package * _undefined_in;
+    mutable unsigned _defined_at;
+    mutable size_t _size;
+    mutable name_set _free;
+    mutable name_set _names;
+
+    void invalidate() {
+        for(component * node = this; node != nullptr && node->_cached; node = node->_parent)
+            node->_cached = false;
+    }
+    void copy_cache(const component& in) {
+        _cached = in._cached;
+        _undefined = in._undefined;
+        _undefined_mixed = in._undefined_mixed;
+        _undefined_in = in._undefined_in;
+        _defined_at = in._defined_at;
+        _size = in._size;
+        _free = in._free;
+        _names = in._names;
+    }
+    void refresh() const;
+    /**sets the contexts watched for definitions to those of `a` and `b`, see `_undefined_in`**/
+    void watch_undefined(const component& a, const component& b) const {
+        _undefined_mixed = a._undefined_mixed || b._undefined_mixed ||
+            (a._undefined_in != nullptr && b._undefined_in != nullptr && a._undefined_in != b._undefined_in);
+        _undefined_in = a._undefined_in != nullptr ? a._undefined_in : b._undefined_in;
+    }
+    /**adds every identifier `name` in `scope` that is free in this subtree to `found`, leftmost first**/
+    void find_ids(symbol name, package * scope, std::vector<component*>& found);
+
+    static void count_allocation() {
+        ++counters.allocated;
+        if(++counters.live > counters.peak)
+            counters.peak = counters.live;
+    }
+
 public:
     component& copy(const component& in) {
+        counters.copied_bytes += sizeof(component);
         nullable<component> head = in._head;//these are necessary to prevent loss of data if in is a child or this
         nullable<component> tail = in._tail;
 
+        copy_cache(in);
         _parent = nullptr;
         _scope = in._scope;
         _name = in._name;
+        _slot = in._slot;
+        _origin = in._origin;
         _head = std::move(head);
         _tail = std::move(tail);
         if(!_head.null()) {
             _head.get().parent() = this;
         }
         if(!_tail.null()) {
-            _head.get().parent() = this;
+            _tail.get().parent() = this;
         }
         return *this;
     }
+    /**
+     * takes the subtrees of `in` without copying them, leaving `in` with none. `in` may be this or a
+     * descendant of it, but not an ancestor
+     **/
     component& steal(component&& in) {
-        nullable<component> head = in._head;//these are necessary to prevent loss of data if in is a child or this
-        nullable<component> tail = in._tail;
-
+        nullable<component> head = std::move(in._head);//in may be a child, which assigning _head or _tail deletes
+        nullable<component> tail = std::move(in._tail);
+
+        _cached = in._cached;
+        _undefined = in._undefined;
+        _undefined_mixed = in._undefined_mixed;
+        _undefined_in = in._undefined_in;
+        _defined_at = in._defined_at;
+        _size = in._size;
+        _free = std::move(in._free);
+        _names = std::move(in._names);
+        in._cached = false;
         _parent = nullptr;
-        _scope = std::move(in._scope);
-        _name = std::move(in._name);
+        _scope = in._scope;
+        _name = in._name;
+        _slot = in._slot;
+        _origin = in._origin;
         _head = std::move(head);
         _tail = std::move(tail);
         if(!_head.null()) {
             _head.get().parent() = this;
         }
         if(!_tail.null()) {
-            _head.get().parent() = this;
+            _tail.get().parent() = this;
         }
 
         assert(is_deep_alloc());
         return *this;
     }
     component() {
+        count_allocation();
         _parent = nullptr;
         _scope = nullptr;
+        _name = no_symbol;
+        _slot = nullptr;
+        _origin = nullptr;
+        _cached = false;
+        _undefined = false;
+        _undefined_mixed = false;
+        _undefined_in = nullptr;
+        _defined_at = 0;
+        _size = 0;
     }
     component(const component& in) {
+        count_allocation();
         copy(in);
     }
     component(component&& in) {
+        count_allocation();
         steal(std::move(in));
     }
+    ~component() {
+        ++counters.freed;
+        --counters.live;
+    }
     component& operator=(const component& in) { 
         return copy(in);
     }
@@ -142,12 +408,16 @@ public:
         component * temp_parent = parent();
         *this = copy;
         parent() = temp_parent;
+        if(temp_parent != nullptr)
+            temp_parent->invalidate();
         return *this;
     }
     component& copy_preserve_parent(component&& steal) {
         component * temp_parent = parent();
         *this = std::move(steal);
         parent() = temp_parent;
+        if(temp_parent != nullptr)
+            temp_parent->invalidate();
         assert(is_deep_alloc());
         return *this;
     }
@@ -171,6 +441,8 @@ public:
         return node;
     }
     const package * const scope() const { return _scope; }
+    const profile_frame *& origin() { return _origin; }
+    const profile_frame * origin() const { return _origin; }
 
     component& expr_head() {
         assert(is_expr());
@@ -192,34 +464,46 @@ public:
         assert(is_expr());
         _head.set(copy);
         _head.get().parent() = this;
+        invalidate();
         return _head.get();
     }
     component& expr_head(component&& copy) {
         assert(is_expr());
         _head.set(std::move(copy));
         _head.get().parent() = this;
+        invalidate();
         return _head.get();
     }
     component& expr_tail(const component& copy) {
         assert(is_expr());
         _tail.set(copy);
         _tail.get().parent() = this;
+        invalidate();
         return _tail.get();
     }
     component& expr_tail(component&& steal) {
         assert(is_expr());
         _tail.set(std::move(steal));
         _tail.get().parent() = this;
+        invalidate();
         return _tail.get();
     }
 
-    std::string& id_name() {
+    const std::string& id_name() const {
         assert(is_id());
-        return _name.get();
+        return symbols.name(_name);
     }
-    const std::string& id_name() const {
+    symbol id_symbol() const {
+        assert(is_id());
+        return _name;
+    }
+    /**renames an identifier, keeping its scope**/
+    component& id_symbol(symbol name) {
         assert(is_id());
-        return _name.get();
+        _name = name;
+        _slot = nullptr;
+        invalidate();
+        return *this;
     }
 
     component& lambda_arg() {
@@ -242,24 +526,28 @@ public:
         assert(is_lambda());
         _head.set(copy);
         _head.get().parent() = this;
+        invalidate();
         return _head.get();
     }
     component& lambda_arg(component&& steal) {
         assert(is_lambda());
         _head.set(std::move(steal));
         _head.get().parent() = this;
+        invalidate();
         return _head.get();
     }
     component& lambda_out(const component& copy) {
         assert(is_lambda());
         _tail.set(copy);
         _tail.get().parent() = this;
+        invalidate();
         return _tail.get();
     }
     component& lambda_out(component&& steal) {
         assert(is_lambda());
         _tail.set(std::move(steal));
         _tail.get().parent() = this;
+        invalidate();
         return _tail.get();
     }
 
@@ -267,15 +555,23 @@ public:
         _head.nullify();
         _tail.nullify();
         _scope = nullptr;
-        _name.nullify();
-        
+        _name = no_symbol;
+        _slot = nullptr;
+        _origin = nullptr;
+        invalidate();
+
         return *this;
     }
-    component& id(std::string name, package * pkg = &prepkg::bound) {
+    component& id(const std::string& name, package * pkg = &prepkg::bound) {
+        return id(symbols.intern(name), pkg);
+    }
+    component& id(symbol name, package * pkg = &prepkg::bound) {
         _head.nullify();
         _tail.nullify();
         _scope = pkg;
         _name = name;
+        _slot = nullptr;
+        invalidate();
 
         return *this;
     }
@@ -297,7 +593,7 @@ public:
 
         lambda_arg(std::move(new_arg));
         lambda_out(std::move(new_out));
-        _name.nullify();
+        _name = no_symbol;
 
         lambda_arg().parent() = this;
         lambda_out().parent() = this;
@@ -322,7 +618,7 @@ public:
         
         expr_head(std::move(new_head));
         expr_tail(std::move(new_tail));
-        _name.nullify();
+        _name = no_symbol;
 
         expr_head().parent() = this;
         expr_tail().parent() = this;
@@ -335,6 +631,14 @@ public:
     bool is_expr() const { return _scope == &prepkg::expr; }
     bool is_lambda() const { return _scope == &prepkg::lambda; }
     bool is_init() const { return _scope != nullptr; }
+    /**removes the definition tags of the whole subtree, see definition_profiler**/
+    void clear_origins() {
+        _origin = nullptr;
+        if(!_head.null())
+            _head.get().clear_origins();
+        if(!_tail.null())
+            _tail.get().clear_origins();
+    }
     bool is_deep_init() const { 
         if(is_expr()) {
             return expr_head().is_deep_init() && expr_tail().is_deep_init();
@@ -395,22 +699,33 @@ public:
     std::vector<component*> find_steps();
     
     int evaluate_step();
-    int evaluate(int timeout);
+    /**
+     * reduces by `strategy`, giving `trace` the term before each step if it wants them. with `memo`, closed
+     * subterms already in it are replaced by their normal form in one step (still charged the steps they
+     * took), and closed subterms that get reduced are added to it. with `natives`, arithmetic it recognises is
+     * done in one step. the cache is only used in normal order, and native arithmetic only by the strategies
+     * that reduce to a normal form, since either would otherwise reduce further than the strategy does. a term
+     * that grows too large to keep reducing stops the evaluation as a timeout would
+     **/
+    int evaluate(int timeout, normal_form_cache * memo = nullptr, church_natives * natives = nullptr,
+        trace_sink * trace = nullptr, reduction_strategy strategy = reduction_strategy::normal_order);
     int evaluate_expression();
     int simplify_step();
     int simplify(int timeout);
 
-    int replace_ids(std::string replace_name, const component& replace, package * replace_scope = &prepkg::bound);
+    int replace_ids(symbol replace_name, const component& replace, package * replace_scope = &prepkg::bound);
+    /**like replace_ids() above, moving `replace` into the last identifier replaced instead of copying it**/
+    int replace_ids(symbol replace_name, component&& replace, package * replace_scope = &prepkg::bound);
 
-    std::string first_name_not_in_ancestors(std::string base_name) const {
+    symbol first_name_not_in_ancestors(symbol base_name) const {
         if(!bound_in_ancestor(base_name))
             return base_name;
         for(unsigned i = 0; i < std::numeric_limits<unsigned>::max(); ++i) {
-            std::string name = alt_name(base_name, i);
+            symbol name = alt_name(base_name, i);
             if(!bound_in_ancestor(name))
-                return name;            
+                return name;
         }
-        return base_name + "@OVERFLOW";
+        return symbols.intern(symbols.name(base_name) + "@OVERFLOW");
     }
     static std::string alt_name(std::string base_name, unsigned rev) {
         std::string ret = base_name;
@@ -424,81 +739,104 @@ public:
     static unsigned base_rev(std::string name) {
         return name.size() - name.find_first_of('\'');
     }
-    bool bound_from_above(const std::string& check) const {
-        if(is_lambda()) {
-            if(lambda_arg().id_name() == check) {
-                return false;
-            } else {
-                return lambda_out().bound_from_above(check);
-            }
-        } else if (is_expr()) {
-            return expr_head().bound_from_above(check)
-                || expr_tail().bound_from_above(check);
-        } else if (is_id()) {
-            if(id_name() == check && scope() == &prepkg::bound) {
-                return true;
-            } else {
-                return false;
-            }
-        } else {
-            throw std::logic_error("component not a lambda, expression, or identifier");
-        }
+    static symbol alt_name(symbol base_name, unsigned rev) {
+        return symbols.primed(base_name, rev);
     }
-    bool bound_above_below(const std::string& check) const {
-        if(is_lambda()) {
-            if(lambda_arg().id_name() == check) {
-                return true;
-            } else {
-                return lambda_out().bound_above_below(check);
-            }
-        } else if (is_expr()) {
-            return expr_head().bound_above_below(check)
-                || expr_tail().bound_above_below(check);
-        } else if (is_id()) {
-            if(id_name() == check && scope() == &prepkg::bound) {
-                return true;
-            } else {
-                return false;
-            }
-        } else {
-            throw std::logic_error("component not a lambda, expression, or identifier");
-        }
+    static symbol base_name(symbol name) {
+        return symbols.base(name);
+    }
+    /**whether a bound identifier named `check` in this subtree is not bound inside it**/
+    bool bound_from_above(symbol check) const {
+        refresh();
+        return std::binary_search(_free->begin(), _free->end(), check);
+    }
+    /**whether `check` is used as a bound identifier or lambda argument anywhere in this subtree**/
+    bool bound_above_below(symbol check) const {
+        refresh();
+        return std::binary_search(_names->begin(), _names->end(), check);
     }
-    bool bound_in_ancestor(std::string check) const {
+    bool bound_in_ancestor(symbol check) const {
         const component * node = this;
         while(node != nullptr) {
-            if(node->is_lambda() && node->lambda_arg().id_name() == check)
+            if(node->is_lambda() && node->lambda_arg().id_symbol() == check)
                 return 1;
             node = node->parent();
         }
         return 0;
     }
-    bool lambda_has_arg(std::string check) const {
+    bool lambda_has_arg(symbol check) const {
         if(!is_lambda())
             return false;
-        if(lambda_arg().id_name() == check)
+        if(lambda_arg().id_symbol() == check)
             return true;
         return lambda_out().lambda_has_arg(check);
     }
+    /**
+     * the current value of a global or packaged identifier, or null if it has none (bound identifiers never
+     * have one). the slot is looked up once, every later call is a pointer read
+     **/
+    const component * id_value() const {
+        assert(is_id());
+        if(_scope == &prepkg::bound)
+            return nullptr;
+        if(_slot == nullptr)
+            _slot = _scope->context()->find_slot(_scope, _name);
+        return _slot->value;
+    }
     bool has_unknown() const;
-    bool has_unknown(std::vector<std::string>& known) const;
+    /**number of nodes in this subtree, counting lambda arguments**/
+    size_t size() const {
+        refresh();
+        return _size;
+    }
+    bool has_unknown(std::vector<symbol>& known) const;
     bool lambda_unknown_before_arg() const;    
-    int lambda_unknown_before_arg(const std::string& argname) const;
+    int lambda_unknown_before_arg(symbol argname) const;
 
     std::string to_string() const;
+    /**appends to_string() to `out`**/
+    void write(std::string& out) const;
+    /**writes to_string() to `out` in pieces, without ever building all of it**/
+    void write(std::ostream& out) const;
+    /**
+     * to_string(), and the span of every node of `steps` in it: where it begins, where its argument begins if it
+     * is an application, and where it ends. spans are in the order the nodes are written
+     **/
     std::pair<std::string, std::vector<step_string_info>> step_string(const std::vector<component*>& steps) const;
+    /**appends to `out` like write(), removing each node it gives a span for from `steps`**/
     std::vector<step_string_info> step_string(std::string& out, std::vector<component*>& steps) const;
 
 
-    bool match_bound(std::string myid, const component& comp, std::string compid) const;
-    bool lambda_arg_match(const component& comp) const;
+    /**
+     * whether the two terms are the same up to the names of bound variables, in time linear in their size.
+     * identifiers that are not bound variables match only if they have the same name and scope
+     **/
     bool compare(const component& comp) const;
+    /**a hash of the term that is the same for any two terms compare() finds equal**/
+    size_t alpha_hash() const;
     bool operator==(const component& comp) { return compare(comp); }
     bool operator!=(const component& comp) { return !compare(comp); }
 
+    /**components made with new come from the pool of the thread, see component_pool**/
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p);
 };
 
+/**
+ * the memory of the calling thread's components. a statement's nodes all go back to it when the statement is
+ * cleared, ready for the next one, and the values of definitions are made from it like everything else
+ **/
+inline thread_local node_pool component_pool(sizeof(component));
+
+inline void * component::operator new(std::size_t size) {
+    assert(size == sizeof(component));
+    return component_pool.allocate();
+}
 
+inline void component::operator delete(void * p) {
+    if(p != nullptr)
+        component_pool.release(p);
+}
 
 }
 
@@ -0,0 +1,85 @@
+#include "engine.h"
+#include "graph.h"
+#include "krivine.h"
+#include "nbe.h"
+#include "bytecode.h"
+#include "parallel.h"
+#include "profile.h"
+
+namespace lambda {
+
+bool engine_from_string(const std::string& name, engine& out) {
+    if(name == "rewrite") {
+        out = engine::rewrite;
+    } else if(name == "graph") {
+        out = engine::graph;
+    } else if(name == "krivine") {
+        out = engine::krivine;
+    } else if(name == "nbe") {
+        out = engine::nbe;
+    } else if(name == "bytecode") {
+        out = engine::bytecode;
+    } else if(name == "parallel") {
+        out = engine::parallel;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool strategy_from_string(const std::string& name, reduction_strategy& out) {
+    if(name == "normal") {
+        out = reduction_strategy::normal_order;
+    } else if(name == "applicative") {
+        out = reduction_strategy::applicative;
+    } else if(name == "whnf") {
+        out = reduction_strategy::weak_head;
+    } else if(name == "hnf") {
+        out = reduction_strategy::head_normal;
+    } else if(name == "cbv") {
+        out = reduction_strategy::closed_by_value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int normalize(component& node, int timeout, engine with, reduction_stats& stats, const engine_options& opts) {
+    switch(with) {
+    case engine::rewrite: {
+        definition_profiler * outer = profiling;
+        profiling = opts.profile;
+        int left = node.evaluate(timeout, opts.memo, opts.natives, opts.trace, opts.strategy);
+        profiling = outer;
+        return left;
+    }
+    case engine::graph: {
+        graph_engine ge;
+        return ge.normalize(node, timeout, stats);
+    }
+    case engine::krivine: {
+        krivine_engine ke;
+        return ke.normalize(node, timeout, stats);
+    }
+    case engine::nbe: {
+        nbe_engine ne;
+        return ne.normalize(node, timeout, stats);
+    }
+    case engine::bytecode: {
+        //one vm per thread for the whole run, so code compiled for a definition is reused by later statements
+        static thread_local bytecode_vm vm;
+        return vm.normalize(node, timeout, stats);
+    }
+    case engine::parallel: {
+        //like the vm, one engine per thread for the whole run, so its pool is not started for every statement
+        static thread_local std::unique_ptr<parallel_engine> pe;
+        unsigned threads = opts.threads != 0 ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+        if(!pe || pe->threads() != threads)
+            pe.reset(new parallel_engine(threads));
+        return pe->normalize(node, timeout, stats);
+    }
+    }
+    throw std::logic_error("unknown engine");
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef LAMBDA_ENGINE_H
+#define LAMBDA_ENGINE_H
+
+#include <string>
+#include "component.h"
+
+namespace lambda {
+
+/**
+ * selects the evaluator used for each statement by load_file
+ **/
+enum class engine {
+    rewrite, //component::evaluate, one printed rewrite per step
+    graph,   //graph_engine, call-by-need graph reduction
+    krivine, //krivine_engine, lazy environment machine
+    nbe,     //nbe_engine, normalization by evaluation with host closures
+    bytecode,//bytecode_vm, compiled once per definition and kept between statements
+    parallel //parallel_engine, normal order with independent subterms reduced on a work-stealing pool
+};
+
+/**
+ * counts of the work an engine did while normalizing a statement
+ **/
+struct reduction_stats {
+    long beta = 0;
+    long delta = 0;
+    long updates = 0;
+};
+
+/**
+ * settings of normalize() that only some engines look at
+ **/
+struct engine_options {
+    /**threads used by engine::parallel, 0 for one per core**/
+    unsigned threads = 0;
+    /**normal forms shared by every statement evaluated with engine::rewrite, or null to not cache them**/
+    normal_form_cache * memo = nullptr;
+    /**arithmetic on church numerals and booleans that engine::rewrite does natively, or null to reduce it**/
+    church_natives * natives = nullptr;
+    /**where engine::rewrite reports each step, and load_file everything else. null reports nothing**/
+    trace_sink * trace = nullptr;
+    /**the order engine::rewrite reduces in**/
+    reduction_strategy strategy = reduction_strategy::normal_order;
+    /**where engine::rewrite charges its work to definitions, or null to not profile**/
+    definition_profiler * profile = nullptr;
+};
+
+/**
+ * parses an engine name as given on the command line. returns false if `name` is not an engine
+ **/
+bool engine_from_string(const std::string& name, engine& out);
+
+/**
+ * parses a reduction strategy name (normal, applicative, whnf, hnf or cbv). returns false if `name` is not one
+ **/
+bool strategy_from_string(const std::string& name, reduction_strategy& out);
+
+/**
+ * evaluates `node` with the given engine, returning what is left of `timeout` like component::evaluate
+ **/
+int normalize(component& node, int timeout, engine with, reduction_stats& stats,
+    const engine_options& opts = engine_options());
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "graph.h"
+
+namespace lambda {
+
+/**thrown out of a reduction once the step budget is used up**/
+struct graph_timeout {};
+
+/**readback of a heavily shared graph can be exponential without taking any steps, so it is capped separately**/
+static const size_t max_readback = 1 << 22;
+
+/**readback recurses once per level of the normal form, and a recursive definition can make that unbounded**/
+static const int max_depth = 1 << 16;
+
+/**counts one level of readback for as long as it is in scope**/
+struct graph_nesting {
+    int& depth;
+    graph_nesting(int& depth) : depth(depth) {
+        if(++depth > max_depth) {
+            --depth;
+            throw graph_timeout();
+        }
+    }
+    ~graph_nesting() { --depth; }
+};
+
+graph_engine::graph_engine() : defs(true) {
+    stats = nullptr;
+    budget = 0;
+    nesting = 0;
+}
+
+graph_node * graph_engine::make(graph_node::kind_t kind) {
+    nodes.push_back(graph_node{kind, nullptr, nullptr, nullptr, no_term, 0});
+    return &nodes.back();
+}
+
+graph_env * graph_engine::bind(graph_node * value, graph_env * next) {
+    envs.push_back(graph_env{value, next});
+    return &envs.back();
+}
+
+void graph_engine::spend() {
+    if(--budget < 0)
+        throw graph_timeout();
+}
+
+graph_node * graph_engine::global_value(term_ref id) {
+    term_ref value = defs.definition(id);
+    if(value == no_term) {
+        uint32_t key = defs[id].a;
+        std::unordered_map<uint32_t, graph_node*>::iterator it = unknowns.find(key);
+        if(it != unknowns.end())
+            return it->second;
+        graph_node * ret = make(graph_node::free);
+        ret->id = id;
+        unknowns[key] = ret;
+        return ret;
+    }
+    std::unordered_map<term_ref, graph_node*>::iterator it = globals.find(value);
+    if(it != globals.end())
+        return it->second;
+    spend();
+    ++stats->delta;
+    //a definition that refers to itself finds this placeholder instead of instantiating itself again
+    graph_node * self = make(graph_node::recursive);
+    globals[value] = self;
+    graph_node * ret = instantiate(value, nullptr);
+    self->a = ret;
+    globals[value] = ret;
+    return ret;
+}
+
+graph_node * graph_engine::instantiate(term_ref t, graph_env * env) {
+    const term_node n = defs[t];
+    switch(n.kind) {
+    case term_kind::var: {
+        graph_env * e = env;
+        for(uint32_t i = 0; i < n.a; ++i)
+            e = e->next;
+        return e->value;
+    }
+    case term_kind::free:
+        return global_value(t);
+    case term_kind::lambda: {
+        graph_node * ret = make(graph_node::closure);
+        ret->body = t;
+        ret->env = env;
+        return ret;
+    }
+    case term_kind::apply: {
+        graph_node * ret = make(graph_node::apply);
+        ret->a = instantiate(n.a, env);
+        ret->b = instantiate(n.b, env);
+        return ret;
+    }
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+graph_node * graph_engine::whnf(graph_node * n) {
+    std::vector<graph_node*> spine;
+    for(;;) {
+        while(n->kind == graph_node::indirect || n->kind == graph_node::recursive) {
+            if(n->kind == graph_node::recursive) {
+                spend();
+                ++stats->delta;
+            }
+            n = n->a;
+        }
+        if(n->kind == graph_node::apply) {
+            spine.push_back(n);
+            n = n->a;
+        } else if(n->kind == graph_node::closure && !spine.empty()) {
+            graph_node * redex = spine.back();
+            spine.pop_back();
+            spend();
+            ++stats->beta;
+            graph_node * result = instantiate(defs[n->body].a, bind(redex->b, n->env));
+            redex->kind = graph_node::indirect;
+            redex->a = result;
+            redex->b = nullptr;
+            ++stats->updates;
+            n = result;
+        } else {
+            return spine.empty() ? n : spine.front();
+        }
+    }
+}
+
+term_ref graph_engine::readback(graph_node * n, uint32_t depth) {
+    if(out.size() > max_readback)
+        throw graph_timeout();
+    graph_nesting nested(nesting);
+    n = whnf(n);
+    switch(n->kind) {
+    case graph_node::closure: {
+        graph_node * arg = make(graph_node::level);
+        arg->id = depth;
+        graph_node * body = instantiate(defs[n->body].a, bind(arg, n->env));
+        term_ref ret = readback(body, depth + 1);
+        return out.lambda(ret, defs.hint(n->body));
+    }
+    case graph_node::level:
+        return out.var(depth - n->id - 1);
+    case graph_node::free:
+        return out.free(defs.free_info(n->id).name, defs.free_info(n->id).scope);
+    case graph_node::apply: {
+        term_ref head = readback(n->a, depth);
+        return out.apply(head, readback(n->b, depth));
+    }
+    case graph_node::indirect:
+    case graph_node::recursive:
+        break;
+    }
+    throw std::logic_error("weak head normal form was an indirection");
+}
+
+int graph_engine::normalize(component& node, int timeout, reduction_stats& stats) {
+    this->stats = &stats;
+    budget = timeout;
+    int left = 0;
+    try {
+        graph_node * root = instantiate(defs.from_component(node), nullptr);
+        term_ref result = readback(root, 0);
+        node = out.to_component(result);
+        left = budget;
+    } catch(graph_timeout&) {
+        left = 0;
+    }
+    nodes.clear();
+    envs.clear();
+    globals.clear();
+    unknowns.clear();
+    return left;
+}
+
+}
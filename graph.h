@@ -0,0 +1,78 @@
+#ifndef LAMBDA_GRAPH_H
+#define LAMBDA_GRAPH_H
+
+#include <deque>
+#include <unordered_map>
+#include "term.h"
+#include "engine.h"
+
+namespace lambda {
+
+struct graph_env;
+
+/**
+ * a vertex of the reduction graph. applications are thunks: once reduced they are overwritten in place with
+ * their weak head normal form (or an indirection to it), so every reference to them sees the result
+ **/
+struct graph_node {
+    enum kind_t {
+        apply,    //a = function, b = argument
+        closure,  //body + env
+        indirect, //a = node this was updated to
+        recursive,//a = value of a definition, as seen from inside that value. passing through costs a delta step
+        level,    //neutral variable introduced by readback, depth = binding level
+        free      //neutral identifier with no known value, id = node in the definition store
+    } kind;
+    graph_node * a;
+    graph_node * b;
+    graph_env * env;
+    term_ref body;
+    uint32_t id;
+};
+
+/**
+ * persistent list of values bound by enclosing lambdas, innermost first
+ **/
+struct graph_env {
+    graph_node * value;
+    graph_env * next;
+};
+
+/**
+ * call-by-need evaluator. a beta step instantiates the lambda body with a pointer to the argument instead of
+ * copying it, so work done on an argument is done once no matter how many times it is used.
+ *
+ * terms are reduced to weak head normal form and then read back under binders into the full normal form.
+ **/
+class graph_engine {
+private:
+    term_store defs;
+    term_store out;
+    std::deque<graph_node> nodes;
+    std::deque<graph_env> envs;
+    std::unordered_map<term_ref, graph_node*> globals;
+    std::unordered_map<uint32_t, graph_node*> unknowns;
+    reduction_stats * stats;
+    long budget;
+    int nesting;
+
+    graph_node * make(graph_node::kind_t kind);
+    graph_env * bind(graph_node * value, graph_env * next);
+    graph_node * instantiate(term_ref t, graph_env * env);
+    graph_node * global_value(term_ref id);
+    graph_node * whnf(graph_node * n);
+    term_ref readback(graph_node * n, uint32_t depth);
+    void spend();
+public:
+    graph_engine();
+
+    /**
+     * replaces `node` with its normal form. returns the unused part of `timeout`, or 0 if it ran out, in which
+     * case `node` is left as it was
+     **/
+    int normalize(component& node, int timeout, reduction_stats& stats);
+};
+
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "image.h"
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lambda {
+
+static const char image_magic[8] = {'L', 'C', 'I', 'M', 'A', 'G', 'E', '\0'};
+
+/**
+ * flattens components into the tables of an image, sharing strings and package names
+ **/
+class image_writer {
+private:
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_index;
+    std::unordered_map<std::string, uint32_t> package_index;
+public:
+    std::vector<uint32_t> packages;
+    std::vector<image_value> values;
+    std::vector<image_node> nodes;
+
+    uint32_t add_string(const std::string& s) {
+        std::unordered_map<std::string, uint32_t>::iterator it = string_index.find(s);
+        if(it != string_index.end())
+            return it->second;
+        uint32_t ret = strings.size();
+        strings.push_back(s);
+        string_index[s] = ret;
+        return ret;
+    }
+    uint32_t add_package(const std::string& name) {
+        std::unordered_map<std::string, uint32_t>::iterator it = package_index.find(name);
+        if(it != package_index.end())
+            return it->second;
+        uint32_t ret = packages.size();
+        packages.push_back(add_string(name));
+        package_index[name] = ret;
+        return ret;
+    }
+    uint32_t node(const component& in);
+    bool write(const std::string& filename) const;
+
+    static std::string package_name(const package * scope);
+    static void collect(const global_package& ctx, std::map<std::string, std::map<std::string, const component*>>& out);
+};
+
+/**the name `scope` is opened with in its context, "global" for the global package**/
+std::string image_writer::package_name(const package * scope) {
+    const global_package * ctx = scope->context();
+    if(ctx != nullptr) {
+        if(scope == &ctx->base)
+            return "global";
+        for(const std::pair<const std::string, package>& p : ctx->packages) {
+            if(&p.second == scope)
+                return p.first;
+        }
+    }
+    throw std::logic_error("identifier scoped to a package that is in no context");
+}
+
+uint32_t image_writer::node(const component& in) {
+    image_node out;
+    if(in.is_lambda()) {
+        out = image_node{image_lambda, add_string(in.lambda_arg().id_name()), node(in.lambda_out())};
+    } else if(in.is_expr()) {
+        uint32_t head = node(in.expr_head());
+        out = image_node{image_expr, head, node(in.expr_tail())};
+    } else if(in.is_id()) {
+        const package * scope = in.scope();
+        uint32_t where;
+        if(scope == &prepkg::bound) {
+            where = 0;
+        } else if(scope->context() != nullptr && scope == scope->context()->global_scope()) {
+            where = 1;
+        } else {
+            where = 2 + add_package(package_name(scope));
+        }
+        out = image_node{image_id, add_string(in.id_name()), where};
+    } else {
+        throw std::logic_error("component not a lambda, expression, or identifier");
+    }
+    nodes.push_back(out);
+    return nodes.size() - 1;
+}
+
+bool image_writer::write(const std::string& filename) const {
+    std::vector<uint32_t> offsets;
+    std::string characters;
+    for(const std::string& s : strings) {
+        offsets.push_back(characters.size());
+        characters += s;
+    }
+    offsets.push_back(characters.size());
+
+    image_header header;
+    std::memcpy(header.magic, image_magic, sizeof(header.magic));
+    header.version = image_version;
+    header.byte_order = image_byte_order;
+    header.strings = strings.size();
+    header.packages = packages.size();
+    header.values = values.size();
+    header.nodes = nodes.size();
+    header.characters = characters.size();
+
+    std::ofstream out(filename, std::ofstream::binary);
+    if(!out.is_open())
+        return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(packages.data()), packages.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(image_value));
+    out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(image_node));
+    out.write(characters.data(), characters.size());
+    return out.good();
+}
+
+/**adds the definitions of `ctx` to `out`, after those of its prelude so that its own take precedence**/
+void image_writer::collect(const global_package& ctx, std::map<std::string, std::map<std::string, const component*>>& out) {
+    if(ctx.prelude)
+        collect(*ctx.prelude, out);
+    ctx.base.for_each_value([&](const std::string& name, const component& value) {
+        out["global"][name] = &value;
+    });
+    for(const std::pair<const std::string, package>& p : ctx.packages) {
+        p.second.for_each_value([&](const std::string& name, const component& value) {
+            out[p.first][name] = &value;
+        });
+    }
+}
+
+bool dump_image(const global_package& ctx, const std::string& filename) {
+    std::map<std::string, std::map<std::string, const component*>> all;
+    image_writer::collect(ctx, all);
+    image_writer writer;
+    writer.add_package("global");
+    for(const std::pair<const std::string, std::map<std::string, const component*>>& p : all) {
+        uint32_t pkg = writer.add_package(p.first);
+        for(const std::pair<const std::string, const component*>& value : p.second) {
+            uint32_t name = writer.add_string(value.first);
+            uint32_t root = writer.node(*value.second);
+            writer.values.push_back(image_value{pkg, name, root});
+        }
+    }
+    return writer.write(filename);
+}
+
+/**
+ * an image mapped into memory, kept alive by the definitions that still have to be built from it
+ **/
+class mapped_image {
+private:
+    void * base = MAP_FAILED;
+    size_t length = 0;
+public:
+    const image_header * header = nullptr;
+    const uint32_t * offsets = nullptr;
+    const uint32_t * packages = nullptr;
+    const image_value * values = nullptr;
+    const image_node * nodes = nullptr;
+    const char * characters = nullptr;
+    /**the loaded context's package for each package of the image**/
+    std::vector<package*> scopes;
+    package * global_scope = nullptr;
+
+    ~mapped_image() {
+        if(base != MAP_FAILED)
+            munmap(base, length);
+    }
+    bool map(const std::string& filename);
+    std::string string(uint32_t index) const {
+        return std::string(characters + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+    component build(uint32_t index) const;
+};
+
+bool mapped_image::map(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(image_header)) {
+        close(fd);
+        return false;
+    }
+    length = info.st_size;
+    base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return false;
+
+    const char * at = static_cast<const char*>(base);
+    header = reinterpret_cast<const image_header*>(at);
+    if(std::memcmp(header->magic, image_magic, sizeof(image_magic)) != 0 ||
+            header->version != image_version || header->byte_order != image_byte_order)
+        return false;
+    size_t expected = sizeof(image_header) +
+        (size_t(header->strings) + 1 + header->packages) * sizeof(uint32_t) +
+        size_t(header->values) * sizeof(image_value) +
+        size_t(header->nodes) * sizeof(image_node) +
+        header->characters;
+    if(expected != length)
+        return false;
+
+    at += sizeof(image_header);
+    offsets = reinterpret_cast<const uint32_t*>(at);
+    at += (size_t(header->strings) + 1) * sizeof(uint32_t);
+    packages = reinterpret_cast<const uint32_t*>(at);
+    at += size_t(header->packages) * sizeof(uint32_t);
+    values = reinterpret_cast<const image_value*>(at);
+    at += size_t(header->values) * sizeof(image_value);
+    nodes = reinterpret_cast<const image_node*>(at);
+    at += size_t(header->nodes) * sizeof(image_node);
+    characters = at;
+
+    //checked once here so that building a value only has to check node indices
+    for(uint32_t i = 0; i < header->strings; ++i) {
+        if(offsets[i] > offsets[i + 1])
+            return false;
+    }
+    if(offsets[header->strings] > header->characters)
+        return false;
+    for(uint32_t i = 0; i < header->packages; ++i) {
+        if(packages[i] >= header->strings)
+            return false;
+    }
+    for(uint32_t i = 0; i < header->values; ++i) {
+        if(values[i].package >= header->packages || values[i].name >= header->strings || values[i].root >= header->nodes)
+            return false;
+    }
+    return true;
+}
+
+component mapped_image::build(uint32_t index) const {
+    const image_node& n = nodes[index];
+    component ret;
+    switch(n.kind) {
+    case image_lambda:
+        if(n.a >= header->strings || n.b >= index)
+            throw std::logic_error("corrupt lambda in prelude image");
+        ret.lambda(component().id(string(n.a)), build(n.b));
+        break;
+    case image_expr:
+        if(n.a >= index || n.b >= index)
+            throw std::logic_error("corrupt expression in prelude image");
+        ret.expr(build(n.a), build(n.b));
+        break;
+    case image_id:
+        if(n.a >= header->strings || n.b >= 2 + scopes.size())
+            throw std::logic_error("corrupt identifier in prelude image");
+        if(n.b == 0)
+            ret.id(string(n.a));
+        else if(n.b == 1)
+            ret.id(string(n.a), global_scope);
+        else
+            ret.id(string(n.a), scopes[n.b - 2]);
+        break;
+    default:
+        throw std::logic_error("unknown node kind in prelude image");
+    }
+    return ret;
+}
+
+bool load_image(const std::string& filename, global_package& ctx) {
+    std::shared_ptr<mapped_image> image = std::make_shared<mapped_image>();
+    if(!image->map(filename))
+        return false;
+    image->global_scope = ctx.global_scope();
+    for(uint32_t i = 0; i < image->header->packages; ++i)
+        image->scopes.push_back(ctx.add_package(image->string(image->packages[i])));
+    for(uint32_t i = 0; i < image->header->values; ++i) {
+        const image_value& value = image->values[i];
+        uint32_t root = value.root;
+        image->scopes[value.package]->add_lazy_value(image->string(value.name), [image, root]() {
+            return image->build(root);
+        });
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef LAMBDA_IMAGE_H
+#define LAMBDA_IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include "component.h"
+
+namespace lambda {
+
+/**
+ * a prelude image is a snapshot of the definitions of a context, written once with dump_image() and mapped
+ * into memory by later runs with load_image().
+ *
+ * everything in it is addressed by index, so it can be mapped anywhere. after the header come, in order:
+ *   uint32_t string_offsets[strings + 1]  start of each string in the character data, then its end
+ *   uint32_t package_names[packages]      string index of each package name, "global" for the global scope
+ *   image_value values[values]
+ *   image_node nodes[nodes]               children always come before their parents
+ *   char characters[]
+ **/
+struct image_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; //image_byte_order as written, so images from hosts of another endianness are refused
+    uint32_t strings;
+    uint32_t packages;
+    uint32_t values;
+    uint32_t nodes;
+    uint32_t characters;
+};
+
+const uint32_t image_version = 1;
+const uint32_t image_byte_order = 0x01020304;
+
+struct image_value {
+    uint32_t package;
+    uint32_t name;
+    uint32_t root;
+};
+
+/**
+ * lambda: `a` is the argument name, `b` the body node. expr: `a` and `b` are the head and tail nodes.
+ * id: `a` is the name, `b` the scope: 0 for bound, 1 for global, or 2 plus a package index
+ **/
+struct image_node {
+    uint32_t kind;
+    uint32_t a;
+    uint32_t b;
+};
+
+enum image_kind : uint32_t { image_lambda, image_expr, image_id };
+
+/**
+ * writes every definition visible in `ctx`, including those of its prelude, to `filename`. returns false if
+ * the file could not be written
+ **/
+bool dump_image(const global_package& ctx, const std::string& filename);
+
+/**
+ * maps the image `filename` and adds its definitions to `ctx`. a definition's body is only built the first
+ * time its name is looked up. returns false if the file could not be mapped or is not a valid image
+ **/
+bool load_image(const std::string& filename, global_package& ctx);
+
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include "krivine.h"
+
+namespace lambda {
+
+/**thrown out of the machine once the step budget is used up**/
+struct krivine_timeout {};
+
+/**readback of shared arguments can be exponential without taking any steps, so it is capped separately**/
+static const size_t max_readback = 1 << 22;
+
+/**readback recurses once per node of the result, so results nested deeper than this are treated as a timeout**/
+static const int max_nesting = 1 << 14;
+
+krivine_engine::krivine_engine() : defs(true) {
+    stats = nullptr;
+    budget = 0;
+    nesting = 0;
+}
+
+void krivine_engine::spend() {
+    if(--budget < 0)
+        throw krivine_timeout();
+}
+
+krivine_thunk * krivine_engine::lookup(term_ref id) {
+    term_ref value = defs.definition(id);
+    term_ref key = value == no_term ? id : value;
+    std::unordered_map<term_ref, krivine_thunk*>::iterator it = globals.find(key);
+    if(it != globals.end())
+        return it->second;
+    thunks.push_back(krivine_thunk{value, nullptr, thunk_state::suspended, krivine_value{}});
+    krivine_thunk * ret = &thunks.back();
+    if(value == no_term) {
+        ret->state = thunk_state::evaluated;
+        ret->value = krivine_value{true, id, nullptr, 0, nullptr};
+    } else {
+        spend();
+        ++stats->delta;
+    }
+    globals[key] = ret;
+    return ret;
+}
+
+krivine_thunk * krivine_engine::suspend(term_ref t, krivine_env * env) {
+    const term_node n = defs[t];
+    if(n.kind == term_kind::var) {
+        for(uint32_t i = 0; i < n.a; ++i)
+            env = env->next;
+        return env->value;
+    } else if(n.kind == term_kind::free) {
+        return lookup(t);
+    }
+    thunks.push_back(krivine_thunk{t, env, thunk_state::suspended, krivine_value{}});
+    if(n.kind == term_kind::lambda) {
+        thunks.back().state = thunk_state::evaluated;
+        thunks.back().value = krivine_value{false, t, env, 0, nullptr};
+    }
+    return &thunks.back();
+}
+
+krivine_value krivine_engine::run(term_ref t, krivine_env * env) {
+    size_t base = stack.size();
+    krivine_value v;
+    for(;;) {
+        const term_node n = defs[t];
+        krivine_thunk * th = nullptr;
+        if(n.kind == term_kind::apply) {
+            stack.push_back(frame{false, suspend(n.b, env)});
+            t = n.a;
+            continue;
+        } else if(n.kind == term_kind::var) {
+            th = env->value;
+            for(uint32_t i = 0; i < n.a; ++i) {
+                env = env->next;
+                th = env->value;
+            }
+        } else if(n.kind == term_kind::free) {
+            th = lookup(t);
+        } else {
+            v = krivine_value{false, t, env, 0, nullptr};
+        }
+        if(th != nullptr) {
+            if(th->state != thunk_state::evaluated) {
+                if(!enter_thunk(*th))
+                    throw krivine_timeout();
+                stack.push_back(frame{true, th});
+                t = th->term;
+                env = th->env;
+                continue;
+            }
+            v = th->value;
+        }
+
+        //return v to the continuation
+        bool resumed = false;
+        while(!resumed) {
+            if(stack.size() == base)
+                return v;
+            frame f = stack.back();
+            stack.pop_back();
+            if(f.update) {
+                f.thunk->state = thunk_state::evaluated;
+                f.thunk->value = v;
+                ++stats->updates;
+            } else if(!v.neutral) {
+                spend();
+                ++stats->beta;
+                envs.push_back(krivine_env{f.thunk, v.env});
+                env = &envs.back();
+                t = defs[v.term].a;
+                resumed = true;
+            } else {
+                spines.push_back(krivine_spine{f.thunk, v.args});
+                v.args = &spines.back();
+            }
+        }
+    }
+}
+
+krivine_value krivine_engine::force(krivine_thunk * th) {
+    if(th->state != thunk_state::evaluated) {
+        if(!enter_thunk(*th))
+            throw krivine_timeout();
+        krivine_value v = run(th->term, th->env);
+        th->state = thunk_state::evaluated;
+        th->value = v;
+    }
+    return th->value;
+}
+
+term_ref krivine_engine::readback(const krivine_value& v, uint32_t depth) {
+    if(out.size() > max_readback || nesting >= max_nesting)
+        throw krivine_timeout();
+    ++nesting;
+    term_ref ret = readback_value(v, depth);
+    --nesting;
+    return ret;
+}
+
+term_ref krivine_engine::readback_value(const krivine_value& v, uint32_t depth) {
+    if(!v.neutral) {
+        thunks.push_back(krivine_thunk{no_term, nullptr, thunk_state::evaluated, krivine_value{true, no_term, nullptr, depth, nullptr}});
+        envs.push_back(krivine_env{&thunks.back(), v.env});
+        term_ref body = readback(run(defs[v.term].a, &envs.back()), depth + 1);
+        return out.lambda(body, defs.hint(v.term));
+    }
+    std::vector<krivine_thunk*> args;
+    for(krivine_spine * s = v.args; s != nullptr; s = s->prev)
+        args.push_back(s->arg);
+    term_ref ret;
+    if(v.term == no_term) {
+        ret = out.var(depth - v.level - 1);
+    } else {
+        ret = out.free(defs.free_info(v.term).name, defs.free_info(v.term).scope);
+    }
+    for(std::vector<krivine_thunk*>::reverse_iterator it = args.rbegin(); it != args.rend(); ++it) {
+        term_ref arg = readback(force(*it), depth);
+        ret = out.apply(ret, arg);
+    }
+    return ret;
+}
+
+int krivine_engine::normalize(component& node, int timeout, reduction_stats& stats) {
+    this->stats = &stats;
+    budget = timeout;
+    nesting = 0;
+    int left = 0;
+    try {
+        term_ref result = readback(run(defs.from_component(node), nullptr), 0);
+        node = out.to_component(result);
+        left = budget;
+    } catch(krivine_timeout&) {
+        left = 0;
+    }
+    stack.clear();
+    thunks.clear();
+    envs.clear();
+    spines.clear();
+    globals.clear();
+    return left;
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef LAMBDA_KRIVINE_H
+#define LAMBDA_KRIVINE_H
+
+#include <deque>
+#include <unordered_map>
+#include "term.h"
+#include "engine.h"
+#include "thunk.h"
+
+namespace lambda {
+
+struct krivine_env;
+struct krivine_thunk;
+
+/**
+ * arguments of a stuck application, last argument first
+ **/
+struct krivine_spine {
+    krivine_thunk * arg;
+    krivine_spine * prev;
+};
+
+/**
+ * a weak head normal form: either a lambda closed over an environment, or a neutral head (a variable
+ * introduced by readback or an unknown identifier) applied to arguments
+ **/
+struct krivine_value {
+    bool neutral;
+    term_ref term;       //closure: the lambda. neutral: the free identifier, or no_term for a level
+    krivine_env * env;   //closure only
+    uint32_t level;      //neutral level only
+    krivine_spine * args;//neutral only
+};
+
+/**
+ * a suspended term, overwritten with its value the first time it is forced
+ **/
+struct krivine_thunk {
+    term_ref term;
+    krivine_env * env;
+    thunk_state state;
+    krivine_value value;
+};
+
+struct krivine_env {
+    krivine_thunk * value;
+    krivine_env * next;
+};
+
+/**
+ * lazy Krivine machine. a beta step only pushes the argument thunk onto the environment, the body is never
+ * rewritten, so each step costs the same no matter how large the term is. thunks are updated after their
+ * first evaluation, so shared arguments are evaluated once. a thunk entered again before it is updated needs
+ * its own value, so that is treated like running out of steps.
+ *
+ * weak head normal forms are read back under binders into the full normal form.
+ **/
+class krivine_engine {
+private:
+    /**an entry of the machine's continuation stack**/
+    struct frame {
+        bool update;
+        krivine_thunk * thunk;
+    };
+
+    term_store defs;
+    term_store out;
+    std::deque<krivine_thunk> thunks;
+    std::deque<krivine_env> envs;
+    std::deque<krivine_spine> spines;
+    std::vector<frame> stack;
+    std::unordered_map<term_ref, krivine_thunk*> globals;
+    reduction_stats * stats;
+    long budget;
+    int nesting;
+
+    krivine_thunk * suspend(term_ref t, krivine_env * env);
+    krivine_thunk * lookup(term_ref id);
+    krivine_value run(term_ref t, krivine_env * env);
+    krivine_value force(krivine_thunk * th);
+    term_ref readback(const krivine_value& v, uint32_t depth);
+    term_ref readback_value(const krivine_value& v, uint32_t depth);
+    void spend();
+public:
+    krivine_engine();
+
+    /**
+     * replaces `node` with its normal form. returns the unused part of `timeout`, or 0 if it ran out, in which
+     * case `node` is left as it was
+     **/
+    int normalize(component& node, int timeout, reduction_stats& stats);
+};
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "compile.h"
+#include "image.h"
+#include "memo.h"
+#include "native.h"
+#include "trace.h"
+#include "profile.h"
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+using namespace lambda;
+
+/**
+ * prints how much use the normal form cache and native arithmetic got, if they were on, and writes the
+ * profile to `profile_file`
+ **/
+static void report(const engine_options& tuning, const std::string& profile_file) {
+    if(tuning.profile != nullptr) {
+        std::ofstream out(profile_file);
+        tuning.profile->write(out);
+        if(!out)
+            std::cerr << "could not write profile '" << profile_file << "'\n";
+    }
+    if(tuning.trace != nullptr)
+        tuning.trace->flush();
+    if(tuning.memo != nullptr) {
+        std::cout << "\nmemo: " << tuning.memo->hits() << " hits, " << tuning.memo->misses() << " misses, "
+            << tuning.memo->size() << " entries, " << tuning.memo->bytes() << " bytes\n";
+    }
+    if(tuning.natives != nullptr)
+        std::cout << "\nnative: " << tuning.natives->applied() << " applications\n";
+}
+
+int main(int argc, char ** argv) {
+    load_options opts;
+    const char * filename = nullptr;
+    const char * prelude_file = nullptr;
+    const char * image_file = nullptr;
+    const char * dump_file = nullptr;
+    std::unique_ptr<normal_form_cache> memo;
+    std::unique_ptr<church_natives> natives;
+    std::unique_ptr<trace_sink> trace(new text_trace(std::cout));
+    std::unique_ptr<definition_profiler> profile;
+    std::string profile_file;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg.compare(0, 9, "--engine=") == 0) {
+            if(!engine_from_string(arg.substr(9), opts.with)) {
+                std::cout << "unknown engine '" << arg.substr(9) << "'";
+                return 1;
+            }
+        } else if(arg == "--time") {
+            opts.time = true;
+        } else if(arg == "--verify") {
+            opts.verify = true;
+        } else if(arg.compare(0, 10, "--prelude=") == 0) {
+            prelude_file = argv[i] + 10;
+        } else if(arg.compare(0, 8, "--image=") == 0) {
+            image_file = argv[i] + 8;
+        } else if(arg.compare(0, 13, "--dump-image=") == 0) {
+            dump_file = argv[i] + 13;
+        } else if(arg.compare(0, 10, "--threads=") == 0) {
+            opts.tuning.threads = std::stoul(arg.substr(10));
+        } else if(arg.compare(0, 8, "--steps=") == 0) {
+            opts.steps = std::stoi(arg.substr(8));
+        } else if(arg.compare(0, 11, "--strategy=") == 0) {
+            if(!strategy_from_string(arg.substr(11), opts.tuning.strategy)) {
+                std::cout << "unknown reduction strategy '" << arg.substr(11) << "'";
+                return 1;
+            }
+        } else if(arg == "--trace=none") {
+            trace.reset();
+        } else if(arg == "--trace=results") {
+            trace.reset(new text_trace(std::cout, false));
+        } else if(arg == "--trace=text") {
+            trace.reset(new text_trace(std::cout));
+        } else if(arg == "--trace=json") {
+            trace.reset(new json_trace(std::cout));
+        } else if(arg.compare(0, 13, "--trace=json:") == 0) {
+            json_trace * json = new json_trace(arg.substr(13));
+            trace.reset(json);
+            if(!json->is_open()) {
+                std::cout << "could not write trace '" << arg.substr(13) << "'";
+                return 1;
+            }
+        } else if(arg.compare(0, 15, "--trace=binary:") == 0) {
+            binary_trace * binary = new binary_trace(arg.substr(15));
+            trace.reset(binary);
+            if(!binary->is_open()) {
+                std::cout << "could not write trace '" << arg.substr(15) << "'";
+                return 1;
+            }
+        } else if(arg.compare(0, 10, "--profile=") == 0) {
+            //beta:FILE, nodes:FILE or sample:PERIOD:FILE
+            std::string spec = arg.substr(10);
+            std::string::size_type colon = spec.find(':');
+            std::string kind = spec.substr(0, colon);
+            if(colon == std::string::npos || (kind != "beta" && kind != "nodes" && kind != "sample")) {
+                std::cout << "unknown profile '" << spec << "'";
+                return 1;
+            }
+            profile_file = spec.substr(colon + 1);
+            if(kind == "sample") {
+                colon = profile_file.find(':');
+                if(colon == std::string::npos) {
+                    std::cout << "sampled profile needs a period, as in sample:1000:FILE";
+                    return 1;
+                }
+                profile.reset(new definition_profiler(definition_profiler::mode::sample,
+                    std::stol(profile_file.substr(0, colon))));
+                profile_file = profile_file.substr(colon + 1);
+            } else {
+                profile.reset(new definition_profiler(kind == "beta" ?
+                    definition_profiler::mode::beta : definition_profiler::mode::nodes));
+            }
+            opts.tuning.profile = profile.get();
+        } else if(arg == "--native") {
+            natives.reset(new church_natives());
+            opts.tuning.natives = natives.get();
+        } else if(arg == "--memo" || arg.compare(0, 7, "--memo=") == 0) {
+            //the cap is given in megabytes
+            size_t cap = arg.size() > 7 ? std::stoul(arg.substr(7)) : 64;
+            memo.reset(new normal_form_cache(cap << 20));
+            opts.tuning.memo = memo.get();
+        } else {
+            filename = argv[i];
+        }
+    }
+    opts.tuning.trace = trace.get();
+    if(filename == nullptr) {
+        std::cout << "must input a file";
+        return 1;
+    }
+    if(prelude_file == nullptr && image_file == nullptr) {
+        load_file(filename, global, opts);
+        report(opts.tuning, profile_file);
+        if(dump_file != nullptr && !dump_image(global, dump_file)) {
+            std::cout << "could not write image '" << dump_file << "'";
+            return 1;
+        }
+        return 0;
+    }
+    //the file gets a context of its own on top of the prelude, as each job of a batch would
+    std::shared_ptr<global_package> prelude = std::make_shared<global_package>();
+    if(image_file != nullptr && !load_image(image_file, *prelude)) {
+        std::cout << "could not load image '" << image_file << "'";
+        return 1;
+    }
+    if(prelude_file != nullptr && !load_file(prelude_file, *prelude, opts)) {
+        std::cout << "could not open prelude '" << prelude_file << "'";
+        return 1;
+    }
+    global_package ctx(prelude);
+    load_file(filename, ctx, opts);
+    report(opts.tuning, profile_file);
+    if(dump_file != nullptr && !dump_image(ctx, dump_file)) {
+        std::cout << "could not write image '" << dump_file << "'";
+        return 1;
+    }
+    return 0;
+}
+
+
+
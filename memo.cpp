@@ -0,0 +1,78 @@
+#include "memo.h"
+
+namespace lambda {
+
+/**rough size of a node of a cached term, including allocator overhead**/
+static const size_t node_bytes = sizeof(component) + 16;
+
+normal_form_cache::normal_form_cache(size_t max_bytes) : max_bytes(max_bytes) {
+}
+
+/**
+ * the latest redefinitions() of the contexts of the identifiers in `term`. generations only grow, so this
+ * changes exactly when one of those contexts has a name redefined
+ **/
+static unsigned redefined_at(const component& term) {
+    if(term.is_expr())
+        return std::max(redefined_at(term.expr_head()), redefined_at(term.expr_tail()));
+    if(term.is_lambda())
+        return redefined_at(term.lambda_out());
+    if(term.scope() == &prepkg::bound || term.scope()->context() == nullptr)
+        return 0;
+    return term.scope()->context()->redefinitions();
+}
+
+bool normal_form_cache::cacheable(const component& term) {
+    return !term.has_unknown();
+}
+
+const component * normal_form_cache::find(const component& term, int& steps) {
+    std::unordered_map<key, std::list<entry>::iterator, key_hash>::iterator it = index.find(key{term.alpha_hash(), &term});
+    if(it != index.end() && it->second->generation != redefined_at(term)) {
+        used -= it->second->bytes;
+        std::list<entry>::iterator old = it->second;
+        index.erase(it);
+        entries.erase(old);
+        it = index.end();
+    }
+    if(it == index.end()) {
+        ++miss_count;
+        return nullptr;
+    }
+    ++hit_count;
+    entries.splice(entries.begin(), entries, it->second);
+    steps = it->second->steps;
+    return &it->second->normal;
+}
+
+void normal_form_cache::insert(const component& term, const component& normal, int steps) {
+    size_t bytes = (term.size() + normal.size()) * node_bytes + sizeof(entry) + 64;
+    if(bytes > max_bytes)
+        return;
+    key k{term.alpha_hash(), &term};
+    std::unordered_map<key, std::list<entry>::iterator, key_hash>::iterator it = index.find(k);
+    if(it != index.end()) {
+        used -= it->second->bytes;
+        std::list<entry>::iterator old = it->second;
+        index.erase(it);
+        entries.erase(old);
+    }
+    entries.push_front(entry{term, normal, k.hash, redefined_at(term), steps, bytes});
+    k.term = &entries.front().term;
+    index[k] = entries.begin();
+    used += bytes;
+    while(used > max_bytes) {
+        const entry& last = entries.back();
+        index.erase(key{last.hash, &last.term});
+        used -= last.bytes;
+        entries.pop_back();
+    }
+}
+
+void normal_form_cache::clear() {
+    entries.clear();
+    index.clear();
+    used = 0;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef LAMBDA_MEMO_H
+#define LAMBDA_MEMO_H
+
+#include <list>
+#include <unordered_map>
+#include "component.h"
+
+namespace lambda {
+
+/**
+ * remembers the normal forms of closed terms, so a term that was already reduced (by an earlier statement, or
+ * earlier in the same one) can be replaced by its result without reducing it again.
+ *
+ * terms are looked up with component::alpha_hash and component::compare, so terms that only differ in the
+ * names of bound variables share an entry. identifiers with values are compared as they are, so an entry is
+ * only valid as long as no name is redefined in the contexts of its identifiers; it is dropped when it is found
+ * after global_package::redefinitions() of one of them has changed.
+ *
+ * entries are evicted least recently used first once their estimated size passes the cap
+ **/
+class normal_form_cache {
+public:
+    /**`max_bytes` is the cap on the estimated memory used by entries**/
+    explicit normal_form_cache(size_t max_bytes);
+
+    /**whether `term` can be cached: it has no free variables, and every identifier in it has a value**/
+    static bool cacheable(const component& term);
+
+    /**
+     * the normal form cached for `term`, setting `steps` to the number of steps it took, or null if there is
+     * none. counts a hit or miss
+     **/
+    const component * find(const component& term, int& steps);
+    /**caches `normal` as the normal form of `term`, reached in `steps` steps**/
+    void insert(const component& term, const component& normal, int steps);
+    void clear();
+
+    long hits() const { return hit_count; }
+    long misses() const { return miss_count; }
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return used; }
+private:
+    struct entry {
+        component term;
+        component normal;
+        size_t hash;
+        /**the latest redefinitions() of the contexts of the term's identifiers when it was inserted**/
+        unsigned generation;
+        int steps;
+        size_t bytes;
+    };
+    /**a term with its alpha_hash, which is only computed once per lookup**/
+    struct key {
+        size_t hash;
+        const component * term;
+        bool operator==(const key& other) const { return hash == other.hash && term->compare(*other.term); }
+    };
+    struct key_hash {
+        size_t operator()(const key& k) const { return k.hash; }
+    };
+
+    /**most recently used first. keys in the index point at the terms of these entries**/
+    std::list<entry> entries;
+    std::unordered_map<key, std::list<entry>::iterator, key_hash> index;
+    size_t max_bytes;
+    size_t used = 0;
+    long hit_count = 0;
+    long miss_count = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include "native.h"
+#include "krivine.h"
+#include "term.h"
+#include <limits>
+
+namespace lambda {
+
+/**most steps spent normalizing a definition to recognise it, or one argument**/
+static const int normalize_budget = 1 << 14;
+
+/**
+ * largest numeral worked out natively. a result that would be bigger is left to be reduced, which keeps the
+ * arithmetic from overflowing
+ **/
+static const unsigned long max_numeral = std::numeric_limits<unsigned long>::max() / 2;
+
+static component read_reference(const char *& at);
+
+static component read_reference_atom(const char *& at) {
+    if(*at == '(') {
+        ++at;
+        component ret = read_reference(at);
+        ++at;
+        return ret;
+    }
+    if(*at == 'L') {
+        std::vector<std::string> args;
+        for(++at; *at != '.'; ++at)
+            args.push_back(std::string(1, *at));
+        ++at;
+        component ret = read_reference(at);
+        for(std::vector<std::string>::const_reverse_iterator it = args.crbegin(); it != args.crend(); ++it)
+            ret = component().lambda(component().id(*it), std::move(ret));
+        return ret;
+    }
+    return component().id(std::string(1, *at++));
+}
+
+/**
+ * reads a reference definition: single letter variables, L for lambda, and every other definition it uses
+ * written out in parentheses
+ **/
+static component read_reference(const char *& at) {
+    component ret = read_reference_atom(at);
+    while(*at != '\0' && *at != ')')
+        ret = component().expr(std::move(ret), read_reference_atom(at));
+    return ret;
+}
+
+static component normal_reference(const std::string& text) {
+    const char * at = text.c_str();
+    component ret = read_reference(at);
+    krivine_engine ke;
+    reduction_stats stats;
+    if(ke.normalize(ret, normalize_budget, stats) == 0)
+        throw std::logic_error("reference definition has no normal form");
+    return ret;
+}
+
+church_natives::church_natives() {
+    //as in the natural:: and boolean:: packages
+    const std::string t = "(Lxy.x)", f = "(Lxy.y)";
+    const std::string succ = "(Lwsz.s(wsz))", zero = "(Lsz.z)", one = "(" + succ + zero + ")";
+    const std::string is_zero = "(Lx.x(" + t + f + ")" + t + ")";
+    const std::string phi = "(Lpz.z(" + succ + "(p" + t + "))(p" + t + "))";
+    const std::string pred = "(Ln.n" + phi + "(Lz.z" + zero + zero + ")" + f + ")";
+    const std::string add = "(Lab.a" + succ + "b)";
+    const std::string sub = "(Lab.b" + pred + "a)";
+    const std::string mul = "(Lab.a(b" + succ + ")" + zero + ")";
+    const std::string pow = "(Lab.b(" + mul + "a)" + one + ")";
+    const std::string ge = "(Lxy." + is_zero + "(x" + pred + "y))";
+    const std::string le = "(Lxy." + is_zero + "(y" + pred + "x))";
+    const std::string and_ = "(Lxy.xy" + f + ")";
+    const std::string or_ = "(Lxy.x" + t + "y)";
+    const std::string not_ = "(Lx.x" + f + t + ")";
+    const std::string xor_ = "(Lxy.x(" + not_ + "y)y)";
+    const std::string eq = "(Lxy." + and_ + "(" + ge + "xy)(" + le + "xy))";
+    const std::string lt = "(Lxy." + not_ + "(" + ge + "xy))";
+    const std::string gt = "(Lxy." + not_ + "(" + le + "xy))";
+
+    references = {
+        reference{operation::succ, 1, normal_reference(succ)},
+        reference{operation::pred, 1, normal_reference(pred)},
+        reference{operation::add, 2, normal_reference(add)},
+        reference{operation::sub, 2, normal_reference(sub)},
+        reference{operation::mul, 2, normal_reference(mul)},
+        reference{operation::pow, 2, normal_reference(pow)},
+        reference{operation::is_zero, 1, normal_reference(is_zero)},
+        reference{operation::ge, 2, normal_reference(ge)},
+        reference{operation::le, 2, normal_reference(le)},
+        reference{operation::eq, 2, normal_reference(eq)},
+        reference{operation::lt, 2, normal_reference(lt)},
+        reference{operation::gt, 2, normal_reference(gt)},
+        reference{operation::and_, 2, normal_reference(and_)},
+        reference{operation::or_, 2, normal_reference(or_)},
+        reference{operation::not_, 1, normal_reference(not_)},
+        reference{operation::xor_, 2, normal_reference(xor_)}
+    };
+}
+
+const church_natives::reference * church_natives::recognise(const component& id) {
+    //what a value is depends on the other names of its context, so it is worked out again after any of them
+    //is redefined
+    const component * value = id.id_value();
+    unsigned now = id.scope()->context()->redefinitions();
+    std::unordered_map<const component*, std::pair<const reference*, unsigned>>::iterator it = known.find(value);
+    if(it != known.end() && it->second.second == now)
+        return it->second.first;
+
+    const reference * ret = nullptr;
+    component normal = *value;
+    krivine_engine ke;
+    reduction_stats stats;
+    if(ke.normalize(normal, normalize_budget, stats) != 0) {
+        for(const reference& r : references) {
+            if(normal.compare(r.normal)) {
+                ret = &r;
+                break;
+            }
+        }
+    }
+    known[value] = std::make_pair(ret, now);
+    return ret;
+}
+
+/**reads Lsz.s(s(...z)), setting `out` to the number of times s is applied**/
+static bool read_numeral(const component& in, unsigned long& out) {
+    if(!in.is_lambda() || !in.lambda_out().is_lambda())
+        return false;
+    symbol s = in.lambda_arg().id_symbol();
+    symbol z = in.lambda_out().lambda_arg().id_symbol();
+    if(s == z)
+        return false;
+    const component * body = &in.lambda_out().lambda_out();
+    out = 0;
+    while(body->is_expr()) {
+        const component& head = body->expr_head();
+        if(!head.is_id() || head.scope() != &prepkg::bound || head.id_symbol() != s)
+            return false;
+        body = &body->expr_tail();
+        ++out;
+    }
+    return body->is_id() && body->scope() == &prepkg::bound && body->id_symbol() == z;
+}
+
+/**reads Lxy.x as true and Lxy.y as false**/
+static bool read_boolean(const component& in, bool& out) {
+    if(!in.is_lambda() || !in.lambda_out().is_lambda())
+        return false;
+    symbol x = in.lambda_arg().id_symbol();
+    symbol y = in.lambda_out().lambda_arg().id_symbol();
+    const component& body = in.lambda_out().lambda_out();
+    if(x == y || !body.is_id() || body.scope() != &prepkg::bound)
+        return false;
+    out = body.id_symbol() == x;
+    return out || body.id_symbol() == y;
+}
+
+static component make_boolean(bool b) {
+    term_store store;
+    return store.to_component(store.lambda(store.lambda(store.var(b ? 1 : 0), "y"), "x"));
+}
+
+/**a to the power b, or false if that is past max_numeral**/
+static bool power(unsigned long a, unsigned long b, unsigned long& out) {
+    out = 1;
+    for(unsigned long i = 0; i < b && out != 0; ++i) {
+        if(a > 1 && out > max_numeral / a)
+            return false;
+        out *= a;
+        if(a == 1)
+            break;
+    }
+    return true;
+}
+
+bool church_natives::value_of(const component& term, int budget, int& spent, church_value& out) {
+    if(is_numeral(term)) {
+        out.numeral = true;
+        out.number = numbers.at(term.id_symbol());
+        return true;
+    }
+    std::vector<const component*> args;
+    const component * head = &term;
+    for(; head->is_expr(); head = &head->expr_head())
+        args.insert(args.begin(), &head->expr_tail());
+    const reference * op = head->is_id() && head->id_value() != nullptr ? recognise(*head) : nullptr;
+    if(op == nullptr || op->arity != args.size()) {
+        int limit = std::min(budget - spent, normalize_budget);
+        if(limit <= 0)
+            return false;
+        component normal = term;
+        krivine_engine ke;
+        reduction_stats stats;
+        int left = ke.normalize(normal, limit, stats);
+        if(left == 0)
+            return false;
+        spent += limit - left;
+        out.boolean = read_boolean(normal, out.truth);
+        out.numeral = read_numeral(normal, out.number);
+        return out.boolean || out.numeral;
+    }
+
+    bool logical = op->which == operation::and_ || op->which == operation::or_ ||
+        op->which == operation::not_ || op->which == operation::xor_;
+    unsigned long n[2] = {0, 0};
+    bool b[2] = {false, false};
+    for(size_t i = 0; i < args.size(); ++i) {
+        church_value arg;
+        if(!value_of(*args[i], budget, spent, arg) || !(logical ? arg.boolean : arg.numeral))
+            return false;
+        n[i] = arg.number;
+        b[i] = arg.truth;
+    }
+
+    out.numeral = true;
+    switch(op->which) {
+    case operation::succ: out.number = n[0] + 1; break;
+    case operation::pred: out.number = n[0] == 0 ? 0 : n[0] - 1; break;
+    case operation::add: out.number = n[0] + n[1]; break;
+    case operation::sub: out.number = n[0] > n[1] ? n[0] - n[1] : 0; break;
+    case operation::mul:
+        if(n[0] != 0 && n[1] > max_numeral / n[0])
+            return false;
+        out.number = n[0] * n[1];
+        break;
+    case operation::pow:
+        if(!power(n[0], n[1], out.number))
+            return false;
+        break;
+    default:
+        out.numeral = false;
+        out.boolean = true;
+        switch(op->which) {
+        case operation::is_zero: out.truth = n[0] == 0; break;
+        case operation::ge: out.truth = n[0] >= n[1]; break;
+        case operation::le: out.truth = n[0] <= n[1]; break;
+        case operation::eq: out.truth = n[0] == n[1]; break;
+        case operation::lt: out.truth = n[0] < n[1]; break;
+        case operation::gt: out.truth = n[0] > n[1]; break;
+        case operation::and_: out.truth = b[0] && b[1]; break;
+        case operation::or_: out.truth = b[0] || b[1]; break;
+        case operation::not_: out.truth = !b[0]; break;
+        case operation::xor_: out.truth = b[0] != b[1]; break;
+        default: throw std::logic_error("unknown native operation");
+        }
+    }
+    return !out.numeral || out.number <= max_numeral;
+}
+
+bool church_natives::apply(component& node, int budget, int& used) {
+    if(!node.is_expr() || &node == building)
+        return false;
+    const component * head = &node;
+    unsigned args = 0;
+    for(; head->is_expr(); head = &head->expr_head())
+        ++args;
+    //a boolean only where it is about to choose between the two terms it is applied to, so it is never seen
+    const component * choice = node.parent();
+    bool choosing = choice != nullptr && choice->is_expr() && &choice->expr_head() == &node &&
+        choice->parent() != nullptr && choice->parent()->is_expr() && &choice->parent()->expr_head() == choice;
+    //anything but a recognised definition applied to all of its arguments, like a native numeral applied to
+    //something, is normalized to find its value, which is only worth it for a choice
+    if(!choosing) {
+        const reference * op = head->is_id() && head->id_value() != nullptr ? recognise(*head) : nullptr;
+        if(op == nullptr || op->which >= operation::is_zero || op->arity != args)
+            return false;
+    } else if(!is_numeral(*head) && (!head->is_id() || head->id_value() == nullptr || recognise(*head) == nullptr)) {
+        return false;
+    }
+
+    church_value value;
+    int spent = 0;
+    if(!value_of(node, budget, spent, value))
+        return false;
+    if(choosing && value.boolean) {
+        node.copy_preserve_parent(make_boolean(value.truth));
+        used = spent;
+    } else if(value.numeral) {
+        //the steps of a numeral are counted when it is built, if it ever is
+        node.copy_preserve_parent(make_numeral(node, value.number));
+        used = 0;
+    } else {
+        return false;
+    }
+    ++applied_count;
+    return true;
+}
+
+component church_natives::make_numeral(const component& from, unsigned long number) {
+    symbol name = symbols.intern("#" + std::to_string(numbers.size()));
+    numerals.add_value(symbols.name(name), from);
+    numbers[name] = number;
+    return component().id(name, numerals.global_scope());
+}
+
+bool church_natives::is_numeral(const component& node) const {
+    return node.is_id() && node.scope() == numerals.global_scope();
+}
+
+bool church_natives::has_numeral(const component& node) const {
+    std::vector<const component*> todo(1, &node);
+    while(!todo.empty()) {
+        const component * at = todo.back();
+        todo.pop_back();
+        if(at->is_expr()) {
+            todo.push_back(&at->expr_head());
+            todo.push_back(&at->expr_tail());
+        } else if(at->is_lambda()) {
+            todo.push_back(&at->lambda_out());
+        } else if(is_numeral(*at)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**every native numeral in `node`, found without recursing as deep as the term**/
+static std::vector<component*> numerals_in(component& node, const church_natives& natives) {
+    std::vector<component*> ret;
+    std::vector<component*> todo(1, &node);
+    while(!todo.empty()) {
+        component * at = todo.back();
+        todo.pop_back();
+        if(at->is_expr()) {
+            todo.push_back(&at->expr_head());
+            todo.push_back(&at->expr_tail());
+        } else if(at->is_lambda()) {
+            todo.push_back(&at->lambda_out());
+        } else if(natives.is_numeral(*at)) {
+            ret.push_back(at);
+        }
+    }
+    return ret;
+}
+
+const component * church_natives::build_numeral(symbol name, int budget, int& used, reduction_strategy strategy) {
+    used = 0;
+    std::unordered_map<symbol, component>::const_iterator it = built.find(name);
+    if(it != built.end())
+        return &it->second;
+    //reduction would have reduced the application in place when it got to it, with any numerals it was made
+    //from already reduced, and nothing outside it changes what it reduces to
+    component term = *numerals.get_value(name);
+    int inner = build(term, budget, strategy);
+    if(inner < 0)
+        return nullptr;
+    //recognised definitions are still done natively inside it, but not the application itself again
+    component * outer = building;
+    building = &term;
+    int left = term.evaluate(budget - inner, nullptr, this, nullptr, strategy);
+    building = outer;
+    if(left == 0)
+        return nullptr;
+    used = budget - left;
+    return &(built[name] = std::move(term));
+}
+
+int church_natives::build(component& node, int budget, reduction_strategy strategy) {
+    std::vector<component*> found = numerals_in(node, *this);
+    std::vector<const component*> terms;
+    int spent = 0;
+    for(component * numeral : found) {
+        int used;
+        const component * term = build_numeral(numeral->id_symbol(), budget - spent, used, strategy);
+        if(term == nullptr)
+            return -1;
+        spent += used;
+        terms.push_back(term);
+    }
+    for(size_t i = 0; i < found.size(); ++i)
+        found[i]->copy_preserve_parent(*terms[i]);
+    return spent;
+}
+
+void church_natives::unbuild(component& node) const {
+    for(component * numeral : numerals_in(node, *this)) {
+        numeral->copy_preserve_parent(*numerals.get_value(numeral->id_symbol()));
+        unbuild(*numeral);
+    }
+}
+
+}
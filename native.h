@@ -0,0 +1,99 @@
+#ifndef LAMBDA_NATIVE_H
+#define LAMBDA_NATIVE_H
+
+#include <unordered_map>
+#include <vector>
+#include "component.h"
+
+namespace lambda {
+
+/**
+ * does arithmetic on church numerals and booleans with machine integers instead of beta steps.
+ *
+ * definitions are recognised by what they are rather than what they are called: the value of the identifier
+ * at the head of an application is normalized and compared with the normal forms of the usual definitions of
+ * successor, predecessor, +, -, *, ^, the zero test and comparisons on numerals, and of the boolean
+ * operators. when one is applied to all of its arguments and each of them works out to a numeral or boolean
+ * (Lsz.s(s(...z)), Lxy.x or Lxy.y), natively if it is itself such an application, its value is known.
+ *
+ * component::evaluate does not always reduce a term all the way to its normal form, so the value cannot simply
+ * be put in place of the application. a numeral is kept as a native numeral instead: an identifier whose value
+ * is the application it was made from, which other recognised definitions read the number of directly. once
+ * one is applied to something, or is left in the result, it is built into the term reducing the application
+ * would have left in its place, so what is seen is what pure reduction gives, and building it is where its steps
+ * are counted. a boolean is only put in place of an application about to be applied to the two terms it chooses
+ * between, since the choice is all that is left of it after two more steps, which is also the only place a native
+ * numeral applied to something is worked out. applications whose arguments are not numerals, or do not
+ * normalize in time, are left to be reduced
+ **/
+class church_natives {
+public:
+    church_natives();
+
+    /**
+     * replaces `node` with its value if it is an application of a recognised definition that works out to a
+     * numeral, or to a boolean about to be applied to two more terms, returning true. the arguments are
+     * normalized within `budget` steps, and `used` is set to the steps that took
+     **/
+    bool apply(component& node, int budget, int& used);
+
+    /**whether `node` is a native numeral made by apply()**/
+    bool is_numeral(const component& node) const;
+    /**whether `node` has a native numeral in it**/
+    bool has_numeral(const component& node) const;
+    /**
+     * builds every native numeral in `node` into the term reducing it with `strategy` would have left. returns
+     * the steps that took, or -1 if it would take more than `budget`, in which case `node` is left as it was
+     **/
+    int build(component& node, int budget, reduction_strategy strategy);
+    /**replaces every native numeral in `node` with the application it was made from, which takes no steps**/
+    void unbuild(component& node) const;
+
+    /**number of applications done natively**/
+    long applied() const { return applied_count; }
+private:
+    enum class operation { none, succ, pred, add, sub, mul, pow, is_zero, ge, le, eq, lt, gt, and_, or_, not_, xor_ };
+    struct reference {
+        operation which;
+        unsigned arity;
+        component normal;
+    };
+
+    /**a numeral or a boolean, as worked out by value_of(). Lxy.y is both 0 and false**/
+    struct church_value {
+        bool boolean = false;
+        bool numeral = false;
+        unsigned long number = 0;
+        bool truth = false;
+    };
+
+    std::vector<reference> references;
+    /**what each definition looked up so far turned out to be, and the redefinitions() of its context then**/
+    std::unordered_map<const component*, std::pair<const reference*, unsigned>> known;
+    long applied_count = 0;
+
+    /**holds the native numerals, each an identifier of its global scope with the application it stands for**/
+    global_package numerals;
+    /**the number each native numeral stands for**/
+    std::unordered_map<symbol, unsigned long> numbers;
+    /**the terms native numerals have been built into so far, see build()**/
+    std::unordered_map<symbol, component> built;
+    /**the application a native numeral is being built from, see build_numeral()**/
+    component * building = nullptr;
+
+    /**what the value of `id`, an identifier with one, is**/
+    const reference * recognise(const component& id);
+    /**
+     * the value of `term`, working out applications of recognised definitions natively and normalizing anything
+     * else. steps taken are added to `spent`, which is kept within `budget`
+     **/
+    bool value_of(const component& term, int budget, int& spent, church_value& out);
+    /**a new native numeral for `number`, standing for `from`**/
+    component make_numeral(const component& from, unsigned long number);
+    /**the term native numeral `name` is built into, or null if that takes more than `budget` steps**/
+    const component * build_numeral(symbol name, int budget, int& used, reduction_strategy strategy);
+};
+
+}
+
+#endif
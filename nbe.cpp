@@ -0,0 +1,192 @@
+#include "nbe.h"
+
+namespace lambda {
+
+/**thrown out of the compiled code once the step budget is used up**/
+struct nbe_timeout {};
+
+/**readback of shared arguments can be exponential without taking any steps, so it is capped separately**/
+static const size_t max_readback = 1 << 22;
+
+/**
+ * beta steps that are not in tail position nest host calls, as does reading back a deep term, so a long enough
+ * chain would overflow the stack. going deeper than this is treated like running out of steps
+ **/
+static const int max_depth = 1 << 13;
+
+/**counts one level of host recursion for as long as it is in scope**/
+struct nbe_nesting {
+    int& depth;
+    nbe_nesting(int& depth) : depth(depth) {
+        if(++depth > max_depth) {
+            --depth;
+            throw nbe_timeout();
+        }
+    }
+    ~nbe_nesting() { --depth; }
+};
+
+nbe_engine::nbe_engine() : defs(true) {
+    stats = nullptr;
+    budget = 0;
+    depth = 0;
+}
+
+void nbe_engine::spend() {
+    if(--budget < 0)
+        throw nbe_timeout();
+}
+
+const nbe_code * nbe_engine::compile(term_ref t) {
+    std::unordered_map<term_ref, const nbe_code*>::iterator it = compiled.find(t);
+    if(it != compiled.end())
+        return it->second;
+
+    const term_node n = defs[t];
+    nbe_code code;
+    switch(n.kind) {
+    case term_kind::var: {
+        uint32_t index = n.a;
+        code = [this, index](nbe_env * env) {
+            for(uint32_t i = 0; i < index; ++i)
+                env = env->next;
+            return force(env->value);
+        };
+        break;
+    }
+    case term_kind::free:
+        code = [this, t](nbe_env *) {
+            return force(lookup(t));
+        };
+        break;
+    case term_kind::lambda: {
+        const nbe_code * body = compile(n.a);
+        code = [this, body, t](nbe_env * env) {
+            values.push_back(nbe_value{false, t, nullptr, 0, nullptr});
+            values.back().call = [this, body, env](nbe_thunk * arg) {
+                envs.push_back(nbe_env{arg, env});
+                return (*body)(&envs.back());
+            };
+            return &values.back();
+        };
+        break;
+    }
+    case term_kind::apply: {
+        const nbe_code * head = compile(n.a);
+        const nbe_code * tail = compile(n.b);
+        term_ref arg = n.b;
+        code = [this, head, tail, arg](nbe_env * env) {
+            nbe_value * f = (*head)(env);
+            return apply(f, suspend(arg, tail, env));
+        };
+        break;
+    }
+    }
+    codes.push_back(std::move(code));
+    compiled[t] = &codes.back();
+    return &codes.back();
+}
+
+nbe_thunk * nbe_engine::suspend(term_ref t, const nbe_code * code, nbe_env * env) {
+    const term_node n = defs[t];
+    if(n.kind == term_kind::var) {
+        for(uint32_t i = 0; i < n.a; ++i)
+            env = env->next;
+        return env->value;
+    } else if(n.kind == term_kind::free) {
+        return lookup(t);
+    }
+    thunks.push_back(nbe_thunk{code, env, nullptr});
+    return &thunks.back();
+}
+
+nbe_thunk * nbe_engine::lookup(term_ref id) {
+    term_ref value = defs.definition(id);
+    term_ref key = value == no_term ? id : value;
+    std::unordered_map<term_ref, nbe_thunk*>::iterator it = globals.find(key);
+    if(it != globals.end())
+        return it->second;
+    if(value == no_term) {
+        values.push_back(nbe_value{true, id, nullptr, 0, nullptr});
+        thunks.push_back(nbe_thunk{nullptr, nullptr, &values.back()});
+    } else {
+        spend();
+        ++stats->delta;
+        thunks.push_back(nbe_thunk{compile(value), nullptr, nullptr});
+    }
+    globals[key] = &thunks.back();
+    return &thunks.back();
+}
+
+nbe_value * nbe_engine::force(nbe_thunk * th) {
+    if(th->value == nullptr) {
+        nbe_nesting nest(depth);
+        nbe_value * v = (*th->code)(th->env);
+        th->value = v;
+        ++stats->updates;
+    }
+    return th->value;
+}
+
+nbe_value * nbe_engine::apply(nbe_value * f, nbe_thunk * arg) {
+    if(f->neutral) {
+        spines.push_back(nbe_spine{arg, f->args});
+        values.push_back(nbe_value{true, f->term, nullptr, f->level, &spines.back()});
+        return &values.back();
+    }
+    spend();
+    ++stats->beta;
+    nbe_nesting nest(depth);
+    return f->call(arg);
+}
+
+term_ref nbe_engine::readback(nbe_value * v, uint32_t level) {
+    if(out.size() > max_readback)
+        throw nbe_timeout();
+    nbe_nesting nest(depth);
+    if(!v->neutral) {
+        values.push_back(nbe_value{true, no_term, nullptr, level, nullptr});
+        thunks.push_back(nbe_thunk{nullptr, nullptr, &values.back()});
+        nbe_value * body = v->call(&thunks.back());
+        term_ref ret = readback(body, level + 1);
+        return out.lambda(ret, defs.hint(v->term));
+    }
+    std::vector<nbe_thunk*> args;
+    for(nbe_spine * s = v->args; s != nullptr; s = s->prev)
+        args.push_back(s->arg);
+    term_ref ret;
+    if(v->term == no_term) {
+        ret = out.var(level - v->level - 1);
+    } else {
+        ret = out.free(defs.free_info(v->term).name, defs.free_info(v->term).scope);
+    }
+    for(std::vector<nbe_thunk*>::reverse_iterator it = args.rbegin(); it != args.rend(); ++it) {
+        term_ref arg = readback(force(*it), level);
+        ret = out.apply(ret, arg);
+    }
+    return ret;
+}
+
+int nbe_engine::normalize(component& node, int timeout, reduction_stats& stats) {
+    this->stats = &stats;
+    budget = timeout;
+    depth = 0;
+    int left = 0;
+    try {
+        term_ref root = defs.from_component(node);
+        nbe_value * v = (*compile(root))(nullptr);
+        term_ref result = readback(v, 0);
+        node = out.to_component(result);
+        left = budget;
+    } catch(nbe_timeout&) {
+        left = 0;
+    }
+    values.clear();
+    thunks.clear();
+    envs.clear();
+    spines.clear();
+    globals.clear();
+    return left;
+}
+
+}
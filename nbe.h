@@ -0,0 +1,96 @@
+#ifndef LAMBDA_NBE_H
+#define LAMBDA_NBE_H
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include "term.h"
+#include "engine.h"
+
+namespace lambda {
+
+struct nbe_env;
+struct nbe_thunk;
+struct nbe_value;
+
+/**
+ * a compiled term: runs the term in an environment and returns its weak head normal form
+ **/
+typedef std::function<nbe_value*(nbe_env*)> nbe_code;
+
+/**
+ * arguments of a stuck application, last argument first
+ **/
+struct nbe_spine {
+    nbe_thunk * arg;
+    nbe_spine * prev;
+};
+
+/**
+ * a weak head normal form: either a host function standing for a lambda, or a neutral head (a variable
+ * introduced by readback or an unknown identifier) applied to arguments
+ **/
+struct nbe_value {
+    bool neutral;
+    term_ref term;                          //function: the lambda. neutral: the free identifier, or no_term for a level
+    std::function<nbe_value*(nbe_thunk*)> call; //function only, runs the body with the argument bound
+    uint32_t level;                         //neutral level only
+    nbe_spine * args;                       //neutral only
+};
+
+/**
+ * an argument that has not been evaluated yet. `value` is filled in the first time it is forced
+ **/
+struct nbe_thunk {
+    const nbe_code * code;
+    nbe_env * env;
+    nbe_value * value;
+};
+
+struct nbe_env {
+    nbe_thunk * value;
+    nbe_env * next;
+};
+
+/**
+ * normalization by evaluation. each term is compiled once into a tree of host closures, and a beta step is
+ * a native call of the function a lambda compiled to, so the term is never rewritten. arguments are passed
+ * as thunks and evaluated at most once.
+ *
+ * the resulting values are read back under binders into the full normal form.
+ **/
+class nbe_engine {
+private:
+    term_store defs;
+    term_store out;
+    std::deque<nbe_code> codes;
+    std::unordered_map<term_ref, const nbe_code*> compiled;
+    std::deque<nbe_value> values;
+    std::deque<nbe_thunk> thunks;
+    std::deque<nbe_env> envs;
+    std::deque<nbe_spine> spines;
+    std::unordered_map<term_ref, nbe_thunk*> globals;
+    reduction_stats * stats;
+    long budget;
+    int depth;
+
+    const nbe_code * compile(term_ref t);
+    nbe_thunk * suspend(term_ref t, const nbe_code * code, nbe_env * env);
+    nbe_thunk * lookup(term_ref id);
+    nbe_value * force(nbe_thunk * th);
+    nbe_value * apply(nbe_value * f, nbe_thunk * arg);
+    term_ref readback(nbe_value * v, uint32_t level);
+    void spend();
+public:
+    nbe_engine();
+
+    /**
+     * replaces `node` with its normal form. returns the unused part of `timeout`, or 0 if it ran out, in which
+     * case `node` is left as it was
+     **/
+    int normalize(component& node, int timeout, reduction_stats& stats);
+};
+
+}
+
+#endif
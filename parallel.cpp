@@ -0,0 +1,240 @@
+#include "parallel.h"
+
+namespace lambda {
+
+/**index of the current thread's queue in the pool it works for. threads outside any pool use 0**/
+static thread_local unsigned worker_index = 0;
+
+/**
+ * normal order reduction can double a term in a single step, so a subterm that grows past this many nodes
+ * is treated as a timeout, like the readback limit of the other engines
+ **/
+static const size_t max_size = 1 << 22;
+
+/**
+ * a waiting task runs other tasks on top of its own stack, so nesting is counted per thread rather than by
+ * the depth of the term. deeper than this is treated as a timeout
+ **/
+static const int max_nesting = 1 << 12;
+static thread_local int nesting = 0;
+
+work_pool::work_pool(unsigned threads) : queued(0), stopping(false) {
+    if(threads == 0)
+        threads = 1;
+    for(unsigned i = 0; i < threads; ++i)
+        queues.push_back(std::unique_ptr<worker_queue>(new worker_queue()));
+    for(unsigned i = 1; i < threads; ++i)
+        this->threads.push_back(std::thread(&work_pool::work, this, i));
+}
+
+work_pool::~work_pool() {
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        stopping = true;
+    }
+    idle.notify_all();
+    for(std::thread& t : threads)
+        t.join();
+}
+
+unsigned work_pool::self() const {
+    return worker_index < queues.size() ? worker_index : 0;
+}
+
+void work_pool::spawn(join& group, std::function<void()> work) {
+    ++group.pending;
+    {
+        worker_queue& q = *queues[self()];
+        std::lock_guard<std::mutex> guard(q.lock);
+        q.tasks.push_back(task{&group, std::move(work)});
+    }
+    ++queued;
+    if(queues.size() > 1)
+        idle.notify_one();
+}
+
+void work_pool::sleep(const std::function<bool()>& ready) {
+    std::unique_lock<std::mutex> guard(idle_lock);
+    //the timeout covers a notify that lands between the check in the caller and this wait
+    idle.wait_for(guard, std::chrono::milliseconds(1), ready);
+}
+
+bool work_pool::take(task& out) {
+    unsigned index = self();
+    {
+        worker_queue& own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty()) {
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    for(unsigned i = 1; i < queues.size(); ++i) {
+        worker_queue& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_pool::run(task& t) {
+    try {
+        t.work();
+    } catch(...) {
+        std::lock_guard<std::mutex> guard(t.group->lock);
+        if(!t.group->error)
+            t.group->error = std::current_exception();
+    }
+    if(--t.group->pending == 0 && queues.size() > 1) {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        idle.notify_all();
+    }
+}
+
+void work_pool::wait(join& group) {
+    task t;
+    while(group.pending > 0) {
+        if(take(t))
+            run(t);
+        else
+            sleep([&]() { return group.pending == 0 || queued > 0; });
+    }
+    if(group.error)
+        std::rethrow_exception(group.error);
+}
+
+void work_pool::work(unsigned index) {
+    worker_index = index;
+    task t;
+    while(!stopping) {
+        if(take(t))
+            run(t);
+        else
+            sleep([&]() { return stopping || queued > 0; });
+    }
+}
+
+parallel_engine::parallel_engine(unsigned threads)
+    : pool(threads == 0 ? std::thread::hardware_concurrency() : threads) {
+    budget = 0;
+    stopped = false;
+    beta = 0;
+    delta = 0;
+}
+
+bool parallel_engine::spend() {
+    if(stopped)
+        return false;
+    if(budget.fetch_sub(1) <= 0) {
+        stopped = true;
+        return false;
+    }
+    return true;
+}
+
+void parallel_engine::head_normalize(component& node) {
+    component * focus = &node;
+    for(;;) {
+        if(focus->is_lambda()) {
+            focus = &focus->lambda_out();
+            continue;
+        }
+        component * redex = nullptr;
+        component * head = focus;
+        while(head->is_expr()) {
+            redex = head;
+            head = &head->expr_head();
+        }
+        if(head->is_id()) {
+            const component * value = head->id_value();
+            if(value == nullptr)
+                return;
+            if(!spend())
+                return;
+            ++delta;
+            head->copy_preserve_parent(*value);
+            if(node.size() > max_size) {
+                stopped = true;
+                return;
+            }
+        } else if(redex != nullptr) {
+            if(!spend())
+                return;
+            ++beta;
+            redex->evaluate_expression();
+            if(node.size() > max_size) {
+                stopped = true;
+                return;
+            }
+        } else {
+            throw std::logic_error("cannot evaluate uninitialized expression");
+        }
+    }
+}
+
+void parallel_engine::normalize_subtree(component& node) {
+    if(nesting >= max_nesting) {
+        stopped = true;
+        return;
+    }
+    ++nesting;
+    normalize_nested(node);
+    --nesting;
+}
+
+void parallel_engine::normalize_nested(component& node) {
+    head_normalize(node);
+    if(stopped)
+        return;
+
+    component * spine = &node;
+    while(spine->is_lambda())
+        spine = &spine->lambda_out();
+    std::vector<component*> args;
+    for(; spine->is_expr(); spine = &spine->expr_head()) {
+        component& arg = spine->expr_tail();
+        if(!(arg.is_id() && arg.id_value() == nullptr))
+            args.push_back(&arg);
+    }
+    if(args.empty())
+        return;
+
+    //detached so that reductions in one argument never invalidate caches of nodes another task can see. the
+    //spine is not looked at again until they are put back, and is thrown away if the budget runs out first
+    std::vector<component> detached(args.size());
+    work_pool::join group;
+    for(size_t i = args.size(); i-- > 0;) {
+        detached[i] = std::move(*args[i]);
+        component * subtree = &detached[i];
+        pool.spawn(group, [this, subtree]() { normalize_subtree(*subtree); });
+    }
+    pool.wait(group);
+    if(stopped)
+        return;
+    for(size_t i = 0; i < args.size(); ++i)
+        args[i]->copy_preserve_parent(std::move(detached[i]));
+}
+
+int parallel_engine::normalize(component& node, int timeout, reduction_stats& stats) {
+    budget = timeout;
+    stopped = false;
+    beta = 0;
+    delta = 0;
+    component work = node;
+    normalize_subtree(work);
+    stats.beta += beta;
+    stats.delta += delta;
+    if(stopped)
+        return 0;
+    node.copy_preserve_parent(std::move(work));
+    return budget;
+}
+
+}
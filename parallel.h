@@ -0,0 +1,107 @@
+#ifndef LAMBDA_PARALLEL_H
+#define LAMBDA_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "component.h"
+#include "engine.h"
+
+namespace lambda {
+
+/**
+ * a fixed set of threads, each with its own deque of tasks. a thread pushes and pops work at the back of its
+ * own deque, and when that is empty steals from the front of another's, so the oldest (and usually largest)
+ * pieces of work are the ones that move between threads.
+ *
+ * the thread that makes the pool is worker 0 and only runs tasks while it waits on a join
+ **/
+class work_pool {
+public:
+    /**a group of spawned tasks that one task waits for**/
+    struct join {
+        std::atomic<int> pending{0};
+        std::mutex lock;
+        std::exception_ptr error;
+    };
+
+    /**`threads` counts the calling thread, so 1 runs everything on it**/
+    explicit work_pool(unsigned threads);
+    ~work_pool();
+    work_pool(const work_pool&) = delete;
+    work_pool& operator=(const work_pool&) = delete;
+
+    void spawn(join& group, std::function<void()> work);
+    /**runs queued tasks until every task of `group` has finished, then rethrows the first error one threw**/
+    void wait(join& group);
+    unsigned size() const { return queues.size(); }
+private:
+    struct task {
+        join * group;
+        std::function<void()> work;
+    };
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued;
+    std::atomic<bool> stopping;
+    std::mutex idle_lock;
+    std::condition_variable idle;
+
+    unsigned self() const;
+    /**blocks until `ready` or a task is spawned or a join finishes**/
+    void sleep(const std::function<bool()>& ready);
+    bool take(task& out);
+    void run(task& t);
+    void work(unsigned index);
+};
+
+/**
+ * normal order reduction that reduces independent subterms at the same time.
+ *
+ * a term is first brought to head normal form the same way component::evaluate would, by contracting the
+ * leftmost-outermost redex until the head of the spine is a variable or an identifier with no value. the
+ * arguments of that spine can no longer interact, so each one is moved out of the tree and normalized as a
+ * task of its own, and put back once all of them are done. reducing disjoint subterms in any order gives
+ * the same normal form as doing them left to right, so only the scheduling differs from a sequential run.
+ *
+ * the step budget is shared by every thread, and once it runs out all tasks stop
+ **/
+class parallel_engine {
+private:
+    work_pool pool;
+    std::atomic<long> budget;
+    std::atomic<bool> stopped;
+    std::atomic<long> beta;
+    std::atomic<long> delta;
+
+    bool spend();
+    void head_normalize(component& node);
+    void normalize_subtree(component& node);
+    void normalize_nested(component& node);
+public:
+    /**0 uses one thread per core**/
+    explicit parallel_engine(unsigned threads = 0);
+    /**number of threads reducing, counting the one that calls normalize()**/
+    unsigned threads() const { return pool.size(); }
+
+    /**
+     * replaces `node` with its normal form. returns the unused part of `timeout`, or 0 if it ran out, in which
+     * case `node` is left as it was
+     **/
+    int normalize(component& node, int timeout, reduction_stats& stats);
+};
+
+}
+
+#endif
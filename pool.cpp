@@ -0,0 +1,52 @@
+#include "pool.h"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace lambda {
+
+/**objects carved from each new chunk**/
+static const size_t chunk_nodes = 1 << 12;
+
+/**free lists of threads that exited, with the size of their objects**/
+static std::mutex orphans_lock;
+static std::vector<std::pair<size_t, void*>> orphans;
+
+/**the pools a thread has used, which give up their free lists when it exits**/
+struct pool_exit {
+    std::vector<node_pool*> pools;
+    ~pool_exit() {
+        for(node_pool * p : pools)
+            p->orphan();
+    }
+};
+
+void node_pool::orphan() {
+    if(head == nullptr)
+        return;
+    std::lock_guard<std::mutex> guard(orphans_lock);
+    orphans.push_back(std::make_pair(size, static_cast<void*>(head)));
+    head = nullptr;
+}
+
+void node_pool::refill() {
+    static thread_local pool_exit on_exit;
+    if(std::find(on_exit.pools.begin(), on_exit.pools.end(), this) == on_exit.pools.end())
+        on_exit.pools.push_back(this);
+    {
+        std::lock_guard<std::mutex> guard(orphans_lock);
+        for(std::vector<std::pair<size_t, void*>>::iterator it = orphans.begin(); it != orphans.end(); ++it) {
+            if(it->first == size) {
+                head = static_cast<free_node*>(it->second);
+                orphans.erase(it);
+                return;
+            }
+        }
+    }
+    //never freed, since objects from it may outlive the thread and this pool
+    char * chunk = static_cast<char*>(::operator new(size * chunk_nodes));
+    for(size_t i = chunk_nodes; i-- > 0;)
+        release(chunk + i * size);
+}
+
+}
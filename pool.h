@@ -0,0 +1,51 @@
+#ifndef LAMBDA_POOL_H
+#define LAMBDA_POOL_H
+
+#include <cstddef>
+
+namespace lambda {
+
+/**
+ * memory for objects of one size, carved out of large chunks and kept on a free list per thread, so making
+ * and destroying an object is a couple of pointer moves instead of a call to malloc and free.
+ *
+ * memory may be released on a different thread from the one it was allocated on, which just hands it to that
+ * thread. when a thread exits its free list is handed to the next thread that runs out, and chunks are never
+ * given back, so the pools hold on to as much memory as was ever live at once.
+ *
+ * a pool is meant to be a thread_local. it has no destructor, so objects can still be released into it while
+ * static objects are destroyed at exit
+ **/
+class node_pool {
+private:
+    struct free_node {
+        free_node * next;
+    };
+    free_node * head = nullptr;
+    size_t size;
+
+    /**fills the empty free list from the lists of threads that exited, or a new chunk**/
+    void refill();
+public:
+    constexpr explicit node_pool(size_t size) : size(size < sizeof(free_node) ? sizeof(free_node) : size) {}
+    node_pool(const node_pool&) = delete;
+
+    void * allocate() {
+        if(head == nullptr)
+            refill();
+        free_node * ret = head;
+        head = ret->next;
+        return ret;
+    }
+    void release(void * p) {
+        free_node * node = static_cast<free_node*>(p);
+        node->next = head;
+        head = node;
+    }
+    /**hands the free list on to other threads, as is done for every pool a thread used when it exits**/
+    void orphan();
+};
+
+}
+
+#endif
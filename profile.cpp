@@ -0,0 +1,80 @@
+#include "profile.h"
+#include <map>
+#include <mutex>
+
+namespace lambda {
+
+static std::mutex frames_lock;
+/**every frame ever made. a map, so the frames never move**/
+static std::map<std::pair<const profile_frame*, symbol>, profile_frame> frames;
+
+const profile_frame * profile_child(const profile_frame * parent, symbol name) {
+    if(parent != nullptr && parent->name == name)
+        return parent;
+    std::lock_guard<std::mutex> guard(frames_lock);
+    std::pair<const profile_frame*, symbol> key(parent, name);
+    std::map<std::pair<const profile_frame*, symbol>, profile_frame>::iterator it = frames.find(key);
+    if(it == frames.end())
+        it = frames.emplace(key, profile_frame{parent, name}).first;
+    return &it->second;
+}
+
+definition_profiler::definition_profiler(mode weigh, long period) :
+    weigh(weigh), period(std::max(period, 1L)), until_sample(this->period) {}
+
+void definition_profiler::statement(int line, const std::string& file) {
+    root = profile_child(nullptr, symbols.intern(file + ":" + std::to_string(line)));
+}
+
+const profile_frame * definition_profiler::frame_of(const component& node) const {
+    for(const component * at = &node; at != nullptr; at = at->parent()) {
+        if(at->origin() != nullptr)
+            return at->origin();
+    }
+    return root;
+}
+
+void definition_profiler::charge(const profile_frame * frame, int beta, long nodes) {
+    if(frame == nullptr)
+        return;
+    switch(weigh) {
+    case mode::beta:
+        if(beta != 0)
+            weights[frame] += beta;
+        break;
+    case mode::nodes:
+        if(nodes != 0)
+            weights[frame] += nodes;
+        break;
+    case mode::sample:
+        if(--until_sample == 0) {
+            ++weights[frame];
+            until_sample = period;
+        }
+        break;
+    }
+}
+
+/**a frame name as folded stacks can hold it, without the ';' between frames or the ' ' before the weight**/
+static std::string folded_name(symbol name) {
+    std::string ret = symbols.name(name);
+    for(char& c : ret) {
+        if(c == ';' || c == ' ')
+            c = '_';
+    }
+    return ret;
+}
+
+void definition_profiler::write(std::ostream& out) const {
+    std::map<std::string, long> stacks;
+    for(const std::pair<const profile_frame* const, long>& w : weights) {
+        std::string stack;
+        for(const profile_frame * f = w.first; f != nullptr; f = f->parent)
+            stack = f->parent != nullptr ? ";" + folded_name(f->name) + stack : folded_name(f->name) + stack;
+        stacks[stack] += w.second;
+    }
+    for(const std::pair<const std::string, long>& s : stacks)
+        out << s.first << " " << s.second << "\n";
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef LAMBDA_PROFILE_H
+#define LAMBDA_PROFILE_H
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include "component.h"
+
+namespace lambda {
+
+/**
+ * where a part of a term came from: the definition it was expanded from, inside the frame the identifier that
+ * named it was in. frames without a parent are statements. frames are made once for each parent and name and
+ * never freed, so components can point at them however long they live
+ **/
+struct profile_frame {
+    const profile_frame * parent;
+    /**name of the definition, or "file:line" of the statement**/
+    symbol name;
+};
+
+/**
+ * the frame for definition `name` expanded inside `parent`. an expansion of the definition `parent` is
+ * expanding stays in `parent`, so recursion does not make stacks without end
+ **/
+const profile_frame * profile_child(const profile_frame * parent, symbol name);
+
+/**
+ * charges the work component::evaluate does to the definitions it is done on behalf of, and writes it out in
+ * the folded stack format flame graph tools read: a line per stack, its frames separated by ';', then its
+ * weight.
+ *
+ * while a profiler is set as `profiling` on a thread, the root of every value an identifier is replaced with
+ * is tagged with the identifier's frame, and so is whatever a contraction leaves in place of a lambda and its
+ * argument. the rest of a term belongs to the frame of its nearest tagged ancestor. a contraction is charged
+ * to the frame of the lambda, and an expansion to the frame of the definition.
+ *
+ * exact profiles weigh every contraction (beta) or every component allocated (nodes). sampled profiles
+ * count one in every `period` contractions and expansions, which keeps the cost of bookkeeping low enough to
+ * leave on; tagging is done either way
+ **/
+class definition_profiler {
+public:
+    enum class mode { beta, nodes, sample };
+
+    explicit definition_profiler(mode weigh, long period = 1);
+
+    /**starts a statement, the frame of anything not expanded from a definition**/
+    void statement(int line, const std::string& file);
+    /**the frame `node` belongs to**/
+    const profile_frame * frame_of(const component& node) const;
+    /**charges a contraction (`beta` 1) or expansion (`beta` 0) that allocated `nodes` components to `frame`**/
+    void charge(const profile_frame * frame, int beta, long nodes);
+
+    /**writes every stack with a weight in folded stack format**/
+    void write(std::ostream& out) const;
+private:
+    mode weigh;
+    long period;
+    long until_sample;
+    const profile_frame * root = nullptr;
+    std::unordered_map<const profile_frame*, long> weights;
+};
+
+/**the profiler the rewrite engine reports to on this thread, or null. see engine_options::profile**/
+inline thread_local definition_profiler * profiling = nullptr;
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "symbol.h"
+
+namespace lambda {
+
+symbol_table::symbol_table() : count(0) {
+    for(std::atomic<record*>& chunk : chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+symbol_table::~symbol_table() {
+    for(std::atomic<record*>& chunk : chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+symbol symbol_table::intern_locked(const std::string& name) {
+    std::unordered_map<std::string, symbol>::iterator it = index.find(name);
+    if(it != index.end())
+        return it->second;
+
+    size_t first_prime = name.find_first_of('\'');
+    symbol base = no_symbol;
+    unsigned rev = 0;
+    if(first_prime != std::string::npos) {
+        base = intern_locked(name.substr(0, first_prime));
+        rev = name.size() - first_prime;
+    }
+
+    symbol ret = count.load(std::memory_order_relaxed);
+    size_t offset;
+    unsigned k = chunk_of(ret, offset);
+    record * chunk = chunks[k].load(std::memory_order_relaxed);
+    if(chunk == nullptr) {
+        chunk = new record[size_t(1) << (first_chunk_bits + k)];
+        chunks[k].store(chunk, std::memory_order_release);
+    }
+    chunk[offset] = record{name, base == no_symbol ? ret : base, rev};
+    primes.emplace_back();
+    index[name] = ret;
+    count.store(ret + 1, std::memory_order_release);
+    return ret;
+}
+
+symbol symbol_table::primed(symbol s, unsigned rev) {
+    std::lock_guard<std::mutex> guard(lock);
+    symbol base = at(s).base;
+    if(primes[base].size() <= rev)
+        primes[base].resize(rev + 1, no_symbol);
+    if(primes[base][rev] == no_symbol) {
+        symbol made = intern_locked(at(base).name + std::string(rev, '\''));
+        primes[base][rev] = made;
+    }
+    return primes[base][rev];
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef LAMBDA_SYMBOL_H
+#define LAMBDA_SYMBOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <limits>
+#include <mutex>
+
+namespace lambda {
+
+/**
+ * an interned identifier name. equal names always have equal symbols
+ **/
+typedef uint32_t symbol;
+const symbol no_symbol = std::numeric_limits<symbol>::max();
+
+/**
+ * assigns each distinct identifier name a symbol, and keeps track of how primed names (`x'`, `x''`) relate
+ * to their base name so fresh names can be made without touching strings
+ *
+ * safe to use from several threads at once, since renaming during parallel normalization makes new names.
+ * only making symbols takes the lock: what is known about a symbol never changes once it is made, and is
+ * kept where it never moves, so name(), base() and rev() read it directly
+ **/
+class symbol_table {
+private:
+    struct record {
+        std::string name;
+        symbol base;
+        unsigned rev;
+    };
+    /**chunk k holds the next (first_chunk << k) records, so 32 bits of symbols fit in chunk_count chunks**/
+    static const unsigned first_chunk_bits = 6;
+    static const unsigned chunk_count = 32 - first_chunk_bits;
+
+    std::atomic<record*> chunks[chunk_count];
+    std::atomic<size_t> count;
+    std::vector<std::vector<symbol>> primes; //primes[base][rev], filled in as they are asked for
+    std::unordered_map<std::string, symbol> index;
+    std::mutex lock;
+
+    symbol intern_locked(const std::string& name);
+    /**the chunk symbol `s` is in, and where in it**/
+    static unsigned chunk_of(symbol s, size_t& offset) {
+        size_t i = size_t(s) + (size_t(1) << first_chunk_bits);
+        unsigned k = 0;
+        while(i >> (first_chunk_bits + k + 1))
+            ++k;
+        offset = i - (size_t(1) << (first_chunk_bits + k));
+        return k;
+    }
+    const record& at(symbol s) const {
+        size_t offset;
+        unsigned k = chunk_of(s, offset);
+        return chunks[k].load(std::memory_order_acquire)[offset];
+    }
+public:
+    symbol_table();
+    ~symbol_table();
+    symbol_table(const symbol_table&) = delete;
+
+    /**returns the symbol for `name`, adding it if it is new**/
+    symbol intern(const std::string& name) {
+        std::lock_guard<std::mutex> guard(lock);
+        return intern_locked(name);
+    }
+    const std::string& name(symbol s) const { return at(s).name; }
+    /**the symbol of `s` with its trailing primes removed**/
+    symbol base(symbol s) const { return at(s).base; }
+    /**the number of primes `s` ends with**/
+    unsigned rev(symbol s) const { return at(s).rev; }
+    /**the base of `s` followed by `rev` primes**/
+    symbol primed(symbol s, unsigned rev);
+    size_t size() const { return count.load(std::memory_order_acquire); }
+};
+
+/**table shared by the tokenizer and every component**/
+inline symbol_table symbols;
+
+}
+
+#endif
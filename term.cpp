@@ -0,0 +1,485 @@
+#include "term.h"
+#include <algorithm>
+
+namespace lambda {
+
+static const component * lookup(const term_free& id) {
+    if(id.scope == &prepkg::bound) {
+        return nullptr;
+    } else if(id.scope->context() != nullptr && id.scope == id.scope->context()->global_scope()) {
+        return id.scope->context()->get_value(id.name);
+    } else {
+        return id.scope->get_value(id.name);
+    }
+}
+
+term_store::term_store(bool shared) : shared(shared) {
+    compact_at = 1 << 16;
+}
+
+size_t term_store::bytes() const {
+    size_t ret = nodes.capacity() * sizeof(term_node);
+    for(const term_free& f : frees)
+        ret += sizeof(term_free) + f.name.capacity();
+    for(const std::string& h : hints)
+        ret += sizeof(std::string) + h.capacity();
+    return ret;
+}
+
+term_ref term_store::push(term_kind kind, uint32_t a, uint32_t b) {
+    term_node n{kind, a, b};
+    if(shared) {
+        std::unordered_map<term_node, term_ref, term_node_hash, term_node_equal>::iterator it = consed.find(n);
+        if(it != consed.end())
+            return it->second;
+        consed.emplace(n, nodes.size());
+    }
+    switch(kind) {
+    case term_kind::var:
+        open.push_back(a + 1);
+        break;
+    case term_kind::free:
+        open.push_back(0);
+        break;
+    case term_kind::lambda:
+        open.push_back(open[a] ? open[a] - 1 : 0);
+        break;
+    case term_kind::apply:
+        open.push_back(std::max(open[a], open[b]));
+        break;
+    }
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+term_ref term_store::var(uint32_t index) {
+    return push(term_kind::var, index, 0);
+}
+
+term_ref term_store::lambda(term_ref body, const std::string& hint) {
+    std::unordered_map<std::string, uint32_t>::iterator it = hint_index.find(hint);
+    if(it == hint_index.end()) {
+        it = hint_index.emplace(hint, hints.size()).first;
+        hints.push_back(hint);
+    }
+    return push(term_kind::lambda, body, it->second);
+}
+
+term_ref term_store::apply(term_ref head, term_ref tail) {
+    return push(term_kind::apply, head, tail);
+}
+
+term_ref term_store::free(const std::string& name, package * scope) {
+    std::pair<std::map<std::pair<std::string, package*>, uint32_t>::iterator, bool> it =
+            free_index.emplace(std::make_pair(name, scope), frees.size());
+    if(it.second) {
+        frees.push_back(term_free{name, scope});
+    }
+    return push(term_kind::free, it.first->second, 0);
+}
+
+term_ref term_store::from_component(const component& in) {
+    std::vector<symbol> bound;
+    return from_component(in, bound);
+}
+
+term_ref term_store::from_component(const component& in, std::vector<symbol>& bound) {
+    if(in.is_id()) {
+        if(in.scope() == &prepkg::bound) {
+            for(size_t i = bound.size(); i > 0; --i) {
+                if(bound[i - 1] == in.id_symbol())
+                    return var(bound.size() - i);
+            }
+        }
+        return free(in.id_name(), const_cast<package*>(in.scope()));
+    } else if(in.is_lambda()) {
+        bound.push_back(in.lambda_arg().id_symbol());
+        term_ref body = from_component(in.lambda_out(), bound);
+        bound.pop_back();
+        return lambda(body, in.lambda_arg().id_name());
+    } else if(in.is_expr()) {
+        term_ref head = from_component(in.expr_head(), bound);
+        term_ref tail = from_component(in.expr_tail(), bound);
+        return apply(head, tail);
+    }
+    throw std::logic_error("component not a lambda, expression, or identifier");
+}
+
+void term_store::used_names(term_ref t, uint32_t depth, const std::vector<std::string>& names, std::vector<const std::string*>& out) const {
+    const term_node& n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        if(n.a >= depth)
+            out.push_back(&names[names.size() - 1 - (n.a - depth)]);
+        break;
+    case term_kind::free:
+        if(frees[n.a].scope == &prepkg::bound)
+            out.push_back(&frees[n.a].name);
+        break;
+    case term_kind::lambda:
+        used_names(n.a, depth + 1, names, out);
+        break;
+    case term_kind::apply:
+        used_names(n.a, depth, names, out);
+        used_names(n.b, depth, names, out);
+        break;
+    }
+}
+
+component term_store::to_component(term_ref t) const {
+    std::vector<std::string> names;
+    component ret;
+    to_component(t, names, ret);
+    return ret;
+}
+
+void term_store::to_component(term_ref t, std::vector<std::string>& names, component& out) const {
+    const term_node& n = nodes[t];
+    if(n.kind == term_kind::var) {
+        if(n.a >= names.size())
+            throw std::logic_error("de Bruijn index refers past the outermost lambda");
+        out.id(names[names.size() - 1 - n.a]);
+    } else if(n.kind == term_kind::free) {
+        out.id(frees[n.a].name, frees[n.a].scope);
+    } else if(n.kind == term_kind::lambda) {
+        std::vector<const std::string*> used;
+        used_names(n.a, 1, names, used);
+        const std::string& hint = hints[n.b];
+        std::string name = hint;
+        for(unsigned rev = 1; std::find_if(used.begin(), used.end(), [&](const std::string* s){ return *s == name; }) != used.end(); ++rev) {
+            name = component::alt_name(hint, rev);
+        }
+        names.push_back(name);
+        component body;
+        to_component(n.a, names, body);
+        names.pop_back();
+        out.lambda(component().id(name), std::move(body));
+    } else {
+        component head, tail;
+        to_component(n.a, names, head);
+        to_component(n.b, names, tail);
+        out.expr(std::move(head), std::move(tail));
+    }
+}
+
+std::string term_store::to_string(term_ref t) const {
+    return to_component(t).to_string();
+}
+
+term_ref term_store::definition(term_ref id) {
+    const term_free& info = frees[nodes[id].a];
+    const component * value = lookup(info);
+    if(value == nullptr)
+        return no_term;
+    //a redefinition replaces the value in place, so after any definition in the context the value is converted
+    //again. in a shared store an unchanged value converts back to the same node
+    unsigned now = info.scope->context()->definitions();
+    std::map<const component*, converted>::iterator it = definitions.find(value);
+    if(it != definitions.end() && it->second.generation == now) {
+        it->second.used = true;
+        return it->second.term;
+    }
+    term_ref ret = from_component(*value);
+    definitions[value] = converted{ret, now, true};
+    return ret;
+}
+
+term_ref term_store::shift(term_ref t, int by, uint32_t cutoff) {
+    if(open[t] <= cutoff)
+        return t;
+    bool memoize = shared && cutoff < 0x8000 && by >= 0 && by < 0x8000;
+    uint64_t key = (uint64_t(t) << 32) | (uint64_t(by) << 16) | (uint64_t(cutoff) << 1) | 1;
+    if(memoize) {
+        std::unordered_map<uint64_t, term_ref>::iterator it = memo.find(key);
+        if(it != memo.end())
+            return it->second;
+    }
+    term_ref ret = shift_node(t, by, cutoff);
+    if(memoize)
+        memo[key] = ret;
+    return ret;
+}
+
+term_ref term_store::shift_node(term_ref t, int by, uint32_t cutoff) {
+    term_node n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        return n.a >= cutoff ? var(n.a + by) : t;
+    case term_kind::free:
+        return t;
+    case term_kind::lambda: {
+        term_ref body = shift(n.a, by, cutoff + 1);
+        return body == n.a ? t : push(term_kind::lambda, body, n.b);
+    }
+    case term_kind::apply: {
+        term_ref head = shift(n.a, by, cutoff);
+        term_ref tail = shift(n.b, by, cutoff);
+        return head == n.a && tail == n.b ? t : apply(head, tail);
+    }
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+term_ref term_store::substitute(term_ref t, term_ref arg, uint32_t depth, int& count) {
+    if(open[t] <= depth)
+        return t;
+    bool memoize = shared && depth < 0x8000;
+    uint64_t key = (uint64_t(t) << 32) | (uint64_t(depth) << 1);
+    if(memoize) {
+        std::unordered_map<uint64_t, term_ref>::iterator it = memo.find(key);
+        if(it != memo.end()) {
+            if(it->second != t)
+                ++count;
+            return it->second;
+        }
+    }
+    term_ref ret = substitute_node(t, arg, depth, count);
+    if(memoize)
+        memo[key] = ret;
+    return ret;
+}
+
+term_ref term_store::substitute_node(term_ref t, term_ref arg, uint32_t depth, int& count) {
+    term_node n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        if(n.a == depth) {
+            ++count;
+            return depth == 0 ? arg : shift(arg, depth, 0);
+        }
+        return n.a > depth ? var(n.a - 1) : t;
+    case term_kind::free:
+        return t;
+    case term_kind::lambda: {
+        term_ref body = substitute(n.a, arg, depth + 1, count);
+        return body == n.a ? t : push(term_kind::lambda, body, n.b);
+    }
+    case term_kind::apply: {
+        term_ref head = substitute(n.a, arg, depth, count);
+        term_ref tail = substitute(n.b, arg, depth, count);
+        return head == n.a && tail == n.b ? t : apply(head, tail);
+    }
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+int term_store::replace_ids(term_ref& body, term_ref replace) {
+    int count = 0;
+    body = substitute(body, replace, 0, count);
+    memo.clear();
+    return count;
+}
+
+int term_store::evaluate_expression(term_ref& t) {
+    term_node n = nodes[t];
+    int ret = 0;
+    term_ref head = n.a;
+    if(nodes[head].kind == term_kind::free) {
+        head = definition(head);
+        if(head == no_term)
+            return 0;
+        t = apply(head, n.b);
+        ret = 1;
+    }
+    if(nodes[head].kind == term_kind::lambda) {
+        term_ref body = nodes[head].a;
+        replace_ids(body, n.b);
+        t = body;
+        return 1;
+    }
+    return ret;
+}
+
+bool term_store::has_unknown(term_ref t, uint32_t depth) const {
+    const term_node& n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        return n.a >= depth;
+    case term_kind::free:
+        return lookup(frees[n.a]) == nullptr;
+    case term_kind::lambda:
+        return has_unknown(n.a, depth + 1);
+    case term_kind::apply:
+        return has_unknown(n.a, depth) || has_unknown(n.b, depth);
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+bool term_store::uses(term_ref t, uint32_t index) const {
+    const term_node& n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        return n.a == index;
+    case term_kind::free:
+        return false;
+    case term_kind::lambda:
+        return uses(n.a, index + 1);
+    case term_kind::apply:
+        return uses(n.a, index) || uses(n.b, index);
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+int term_store::unknown_before(term_ref t, uint32_t index) const {
+    const term_node& n = nodes[t];
+    switch(n.kind) {
+    case term_kind::var:
+        return n.a == index ? 2 : 1;
+    case term_kind::free:
+        return lookup(frees[n.a]) == nullptr ? 1 : 0;
+    case term_kind::lambda:
+        return unknown_before(n.a, index + 1);
+    case term_kind::apply:
+        return unknown_before(n.a, index) ?: unknown_before(n.b, index);
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+bool term_store::lambda_unknown_before_arg(term_ref t) const {
+    assert(nodes[t].kind == term_kind::lambda);
+    return uses(nodes[t].a, 0) && unknown_before(nodes[t].a, 0) != 2;
+}
+
+int term_store::evaluate_step(term_ref& t) {
+    term_node n = nodes[t];
+    switch(n.kind) {
+    case term_kind::apply: {
+        term_ref head = n.a;
+        term_ref tail = n.b;
+        if(evaluate_step(head)) {
+            t = apply(head, tail);
+            return 1;
+        }
+        term_kind hk = nodes[head].kind;
+        if (!(hk != term_kind::lambda && has_unknown(head)) &&
+                !(hk == term_kind::lambda && !lambda_unknown_before_arg(head))) { //otherwise value might not even be used
+            if(evaluate_step(tail)) {
+                t = apply(head, tail);
+                return 1;
+            }
+        }
+        if(hk == term_kind::lambda) {
+            return evaluate_expression(t);
+        }
+        return 0;
+    }
+    case term_kind::lambda: {
+        term_ref body = n.a;
+        if(evaluate_step(body)) {
+            t = push(term_kind::lambda, body, n.b);
+            return 1;
+        }
+        return 0;
+    }
+    case term_kind::var:
+        return 0;
+    case term_kind::free: {
+        term_ref value = definition(t);
+        if(value == no_term)
+            return 0;
+        t = value;
+        return 1;
+    }
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+int term_store::evaluate(term_ref& t, int timeout) {
+    while(timeout > 0) {
+        --timeout;
+        if(!evaluate_step(t))
+            break;
+        if(nodes.size() > compact_at) {
+            t = compact(t);
+            compact_at = std::max(compact_at, 2 * nodes.size());
+        }
+    }
+    return timeout;
+}
+
+bool term_store::compare(term_ref a, term_ref b) const {
+    return compare(a, *this, b);
+}
+
+bool term_store::compare(term_ref a, const term_store& other, term_ref b) const {
+    if(this == &other && a == b)
+        return true;
+    const term_node& na = nodes[a];
+    const term_node& nb = other.nodes[b];
+    if(na.kind != nb.kind)
+        return false;
+    switch(na.kind) {
+    case term_kind::var:
+        return na.a == nb.a;
+    case term_kind::free:
+        if(this == &other)
+            return na.a == nb.a;
+        return frees[na.a].scope == other.frees[nb.a].scope && frees[na.a].name == other.frees[nb.a].name;
+    case term_kind::lambda:
+        return compare(na.a, other, nb.a);
+    case term_kind::apply:
+        return compare(na.a, other, nb.a) && compare(na.b, other, nb.b);
+    }
+    throw std::logic_error("term node of unknown kind");
+}
+
+term_ref term_store::copy_into(const term_store& from, term_ref t, std::unordered_map<term_ref, term_ref>& done) {
+    std::unordered_map<term_ref, term_ref>::iterator it = done.find(t);
+    if(it != done.end())
+        return it->second;
+    const term_node& n = from.nodes[t];
+    term_ref ret = 0;
+    switch(n.kind) {
+    case term_kind::var:
+        ret = push(term_kind::var, n.a, 0);
+        break;
+    case term_kind::free:
+        ret = push(term_kind::free, n.a, 0);
+        break;
+    case term_kind::lambda:
+        ret = push(term_kind::lambda, copy_into(from, n.a, done), n.b);
+        break;
+    case term_kind::apply: {
+        term_ref head = copy_into(from, n.a, done);
+        ret = apply(head, copy_into(from, n.b, done));
+        break;
+    }
+    }
+    done[t] = ret;
+    return ret;
+}
+
+term_ref term_store::compact(term_ref root) {
+    term_store old;
+    std::swap(old.nodes, nodes);
+    open.clear();
+    consed.clear();
+    std::unordered_map<term_ref, term_ref> done;
+    term_ref ret = copy_into(old, root, done);
+    for(std::pair<const component* const, converted>& def : definitions) {
+        def.second.term = copy_into(old, def.second.term, done);
+    }
+    return ret;
+}
+
+void term_store::compact_definitions() {
+    term_store old;
+    std::swap(old.nodes, nodes);
+    open.clear();
+    consed.clear();
+    memo.clear();
+    std::unordered_map<term_ref, term_ref> done;
+    //values of contexts that are gone are never looked up again, so they go with the rest
+    std::map<const component*, converted>::iterator it = definitions.begin();
+    while(it != definitions.end()) {
+        if(!it->second.used) {
+            it = definitions.erase(it);
+        } else {
+            it->second.term = copy_into(old, it->second.term, done);
+            it->second.used = false;
+            ++it;
+        }
+    }
+}
+
+}
@@ -0,0 +1,154 @@
+#ifndef LAMBDA_TERM_H
+#define LAMBDA_TERM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "component.h"
+
+namespace lambda {
+
+/**index of a node within a term_store**/
+typedef uint32_t term_ref;
+
+/**returned in place of a term_ref when there is no such term**/
+const term_ref no_term = std::numeric_limits<term_ref>::max();
+
+/**
+ * indicates the type of node stored in a term_node
+ **/
+enum class term_kind : uint8_t {
+    var,    //a = de Bruijn index
+    lambda, //a = body, b = binder name hint
+    apply,  //a = head, b = tail
+    free    //a = index into the store's free identifier table
+};
+
+/**
+ * a single node of a term. nodes never own each other, children are indices into the same store
+ **/
+struct term_node {
+    term_kind kind;
+    uint32_t a;
+    uint32_t b;
+};
+
+static_assert(sizeof(term_node) <= 16, "term_node should stay small enough to pack four to a cache line");
+
+/**
+ * hashes the structure of a node (binder name hints are ignored so alpha equivalent terms collide)
+ **/
+struct term_node_hash {
+    size_t operator()(const term_node& n) const {
+        uint64_t b = n.kind == term_kind::lambda ? 0 : n.b;
+        return std::hash<uint64_t>()((uint64_t(n.kind) << 62) ^ (uint64_t(n.a) << 31) ^ b);
+    }
+};
+struct term_node_equal {
+    bool operator()(const term_node& l, const term_node& r) const {
+        return l.kind == r.kind && l.a == r.a && (l.kind == term_kind::lambda || l.b == r.b);
+    }
+};
+
+/**
+ * an identifier that is not bound by any enclosing lambda. `scope` has the same meaning as component::scope()
+ **/
+struct term_free {
+    std::string name;
+    package * scope;
+};
+
+/**
+ * compact, name free storage for lambda terms
+ *
+ * variables are de Bruijn indices, so alpha equivalent terms are structurally identical. names only exist
+ * as hints on lambdas and are only consulted when converting back to a component for printing.
+ *
+ * nodes are immutable once created; rewriting a term creates new nodes along the changed path and leaves
+ * the old ones for compact() to reclaim.
+ *
+ * a store created with `shared` set is hash-consed: structurally identical subterms are always the same node,
+ * definitions converted into it are stored once however many packages hold them, and the copies made by
+ * beta-reduction collapse onto existing nodes. the first binder name seen for a shape is the one printed.
+ **/
+class term_store {
+private:
+    std::vector<term_node> nodes;
+    std::vector<uint32_t> open;
+    bool shared;
+    std::unordered_map<term_node, term_ref, term_node_hash, term_node_equal> consed;
+    std::unordered_map<uint64_t, term_ref> memo;
+    std::vector<term_free> frees;
+    std::map<std::pair<std::string, package*>, uint32_t> free_index;
+    std::vector<std::string> hints;
+    std::unordered_map<std::string, uint32_t> hint_index;
+    /**a value converted by definition(), as of a generation of the context it was looked up in**/
+    struct converted {
+        term_ref term;
+        unsigned generation;
+        /**whether it was looked up since the last compact_definitions()**/
+        bool used;
+    };
+    std::map<const component*, converted> definitions;
+    size_t compact_at;
+
+    term_ref push(term_kind kind, uint32_t a, uint32_t b);
+    term_ref from_component(const component& in, std::vector<symbol>& bound);
+    void to_component(term_ref t, std::vector<std::string>& names, component& out) const;
+    void used_names(term_ref t, uint32_t depth, const std::vector<std::string>& names, std::vector<const std::string*>& out) const;
+    term_ref shift(term_ref t, int by, uint32_t cutoff);
+    term_ref shift_node(term_ref t, int by, uint32_t cutoff);
+    term_ref substitute(term_ref t, term_ref arg, uint32_t depth, int& count);
+    term_ref substitute_node(term_ref t, term_ref arg, uint32_t depth, int& count);
+    bool uses(term_ref t, uint32_t index) const;
+    int unknown_before(term_ref t, uint32_t index) const;
+    term_ref copy_into(const term_store& from, term_ref t, std::unordered_map<term_ref, term_ref>& done);
+public:
+    term_store(bool shared = false);
+
+    const term_node& operator[](term_ref t) const { return nodes[t]; }
+    const term_free& free_info(term_ref t) const { return frees[nodes[t].a]; }
+    const std::string& hint(term_ref t) const { return hints[nodes[t].b]; }
+    size_t size() const { return nodes.size(); }
+    bool is_shared() const { return shared; }
+    /**number of enclosing lambdas `t` refers past. closed terms have 0**/
+    uint32_t open_depth(term_ref t) const { return open[t]; }
+    size_t bytes() const;
+
+    term_ref var(uint32_t index);
+    term_ref lambda(term_ref body, const std::string& hint);
+    term_ref apply(term_ref head, term_ref tail);
+    term_ref free(const std::string& name, package * scope);
+
+    /**converts a parsed component, resolving names to indices. unbound names become free identifiers**/
+    term_ref from_component(const component& in);
+    /**converts back to a named component, priming binder names where they would capture**/
+    component to_component(term_ref t) const;
+    std::string to_string(term_ref t) const;
+
+    /**the value of a free identifier in its package, converted once per store, or -1 if it is unknown**/
+    term_ref definition(term_ref id);
+
+    int replace_ids(term_ref& body, term_ref replace);
+    int evaluate_expression(term_ref& t);
+    int evaluate_step(term_ref& t);
+    int evaluate(term_ref& t, int timeout);
+
+    bool has_unknown(term_ref t, uint32_t depth = 0) const;
+    bool lambda_unknown_before_arg(term_ref t) const;
+    bool compare(term_ref a, term_ref b) const;
+    bool compare(term_ref a, const term_store& other, term_ref b) const;
+
+    /**
+     * drops every node not reachable from `root`, returning the new index of `root`
+     **/
+    term_ref compact(term_ref root);
+    /**drops every node not reachable from a definition looked up since this was last called**/
+    void compact_definitions();
+};
+
+}
+
+#endif
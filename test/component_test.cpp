@@ -1,8 +1,40 @@
 #include "../component.h"
+#include "../compile.h"
+#include "../native.h"
+#include "../profile.h"
+#include "../trace.h"
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 using namespace lambda;
 
+/**the results load_file prints for `files`, loaded in order into a new context, without their step counts or stats**/
+static std::string results_of(const std::vector<std::string>& files, church_natives * natives,
+    engine with = engine::rewrite) {
+    std::ostringstream printed;
+    text_trace trace(printed, false);
+    load_options opts;
+    opts.with = with;
+    opts.tuning.natives = natives;
+    opts.tuning.trace = &trace;
+    global_package ctx;
+    for(const std::string& file : files)
+        load_file(file, ctx, opts);
+    trace.flush();
+
+    std::istringstream lines(printed.str());
+    std::string ret, line;
+    while(std::getline(lines, line)) {
+        if(!line.empty() && line.back() == '}')
+            line.erase(line.rfind('{'));
+        if(!line.empty() && line.back() == ']')
+            line.erase(line.rfind('['));
+        ret += line + "\n";
+    }
+    return ret;
+}
+
 
 int main() {
     component a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t,u,v,w,x,y,z;
@@ -133,4 +165,112 @@ int main() {
         --max_iter;
     }
 
-}
\ No newline at end of file
+    //two contexts sharing a prelude, each evaluated on its own thread
+    std::shared_ptr<global_package> prelude = std::make_shared<global_package>();
+    prelude->add_value("S", *global.get_value("S"));
+    prelude->add_value("0", *global.get_value("0"));
+
+    global_package first(prelude), second(prelude);
+    first.add_value("1", component().expr(component().id("S", first.global_scope()), component().id("0", first.global_scope())));
+    second.add_value("1", component().id("0", second.global_scope()));
+
+    component in_first, in_second;
+    in_first.id("1", first.global_scope());
+    in_second.id("1", second.global_scope());
+    std::thread t1([&]() { in_first.evaluate(100); });
+    std::thread t2([&]() { in_second.evaluate(100); });
+    t1.join();
+    t2.join();
+    std::cout << "\n" << in_first.to_string() << "\n" << in_second.to_string() << "\n";
+    std::cout << (prelude->get_value("1") == nullptr ? "prelude unchanged" : "PRELUDE CHANGED") << "\n";
+
+    //alpha equivalence: Lx.x, Lx.Ly.x, Lx.Lx.x against renamed and swapped versions
+    component ident = component().lambda(component().id("x"), component().id("x"));
+    component renamed = component().lambda(component().id("y"), component().id("y"));
+    component first_of = component().lambda(component().id("x"), component().lambda(component().id("y"), component().id("x")));
+    component first_swapped = component().lambda(component().id("y"), component().lambda(component().id("x"), component().id("y")));
+    component second_of = component().lambda(component().id("x"), component().lambda(component().id("y"), component().id("y")));
+    component shadowed = component().lambda(component().id("x"), component().lambda(component().id("x"), component().id("x")));
+    std::cout << "\n" << ident.compare(ident) << ident.compare(renamed) << (ident.alpha_hash() == renamed.alpha_hash())
+        << first_of.compare(first_swapped) << (first_of.alpha_hash() == first_swapped.alpha_hash())
+        << !first_of.compare(second_of) << shadowed.compare(second_of) << !shadowed.compare(first_of)
+        << !ident.compare(first_of) << "\n";
+
+    //spans of the steps of S(S0), which are its three identifiers
+    component twice = component().expr(component().id("S", &prepkg::global),
+        component().expr(component().id("S", &prepkg::global), component().id("0", &prepkg::global)));
+    std::pair<std::string, std::vector<step_string_info>> spans = twice.step_string(twice.find_steps());
+    std::cout << "\n" << spans.first << "\n";
+    for(const step_string_info& ssi : spans.second)
+        std::cout << ssi.begin << " " << ssi.middle << " " << ssi.end << "\n";
+
+    //Ly.(Lz.z)y((Lq.q)a) under each strategy
+    component inner = component().lambda(component().id("y"), component().expr(component().expr(
+        component().lambda(component().id("z"), component().id("z")), component().id("y")),
+        component().expr(component().lambda(component().id("q"), component().id("q")), component().id("a"))));
+    const reduction_strategy strategies[] = {reduction_strategy::normal_order, reduction_strategy::applicative,
+        reduction_strategy::weak_head, reduction_strategy::head_normal, reduction_strategy::closed_by_value};
+    std::cout << "\n";
+    for(reduction_strategy strategy : strategies) {
+        component reduced = inner;
+        int left = reduced.evaluate(100, nullptr, nullptr, nullptr, strategy);
+        std::cout << reduced.to_string() << "[" << (100 - left) << "]\n";
+    }
+
+    //Ly.(Lxy.xy)y takes one contraction and one rename, and frees all it allocates once it is gone
+    work_counters snapshot = snapshot_counters();
+    {
+        component renaming = component().lambda(component().id("y"), component().expr(
+            component().lambda(component().id("x"), component().lambda(component().id("y"),
+                component().expr(component().id("x"), component().id("y")))),
+            component().id("y")));
+        renaming.evaluate(100);
+        std::cout << "\n" << renaming.to_string() << "\n";
+    }
+    work_counters done = counted_since(snapshot);
+    std::cout << done.beta << " " << done.renames << " " << (done.allocated == done.freed) << "\n";
+
+    //a contraction moves the body and the last copy of the argument, so (Lx.xx)(Lz.z) copies Lz.z once
+    {
+        component twice = component().expr(
+            component().lambda(component().id("x"), component().expr(component().id("x"), component().id("x"))),
+            component().lambda(component().id("z"), component().id("z")));
+        snapshot = snapshot_counters();
+        twice.evaluate_expression();
+        done = counted_since(snapshot);
+        std::cout << "\n" << twice.to_string() << "\n";
+    }
+    std::cout << done.copied_bytes / sizeof(component) << "\n";
+
+    //S0 contracts the lambda of S once, and the 0 it leaves is not reduced
+    definition_profiler profile(definition_profiler::mode::beta);
+    profiling = &profile;
+    profile.statement(1, "profile");
+    component successor = component().expr(component().id("S", &prepkg::global), component().id("0", &prepkg::global));
+    successor.evaluate(100);
+    profiling = nullptr;
+    std::cout << "\n";
+    profile.write(std::cout);
+
+    //native arithmetic only changes how many steps a result takes
+    const std::vector<std::vector<std::string>> programs = {{"./test/test.lc"},
+        {"./bench/prelude.lc", "./bench/recursion.lc"}};
+    std::cout << "\n";
+    for(const std::vector<std::string>& files : programs) {
+        church_natives natives;
+        bool same = results_of(files, nullptr) == results_of(files, &natives);
+        std::cout << files.back() << (same ? " same with --native, " : " DIFFERS WITH --native, ")
+            << natives.applied() << " applications\n";
+    }
+
+    //a definition that needs itself runs out of steps on every engine instead of overflowing the stack
+    const std::vector<std::string> names = {"graph", "krivine", "nbe", "bytecode", "parallel"};
+    const std::string expected = results_of({"./test/recursive.lc"}, nullptr);
+    std::cout << "\n";
+    for(const std::string& name : names) {
+        engine with;
+        engine_from_string(name, with);
+        bool same = results_of({"./test/recursive.lc"}, nullptr, with) == expected;
+        std::cout << name << (same ? " times out on recursive.lc\n" : " DIFFERS ON recursive.lc\n");
+    }
+}
@@ -0,0 +1,92 @@
+#include "../term.h"
+#include <iostream>
+
+using namespace lambda;
+
+int check(std::string name, const component& in, int timeout = 1000, bool shared = false) {
+    component by_tree = in;
+    int tree_left = by_tree.evaluate(timeout);
+
+    term_store store(shared);
+    term_ref by_term = store.from_component(in);
+    int term_left = store.evaluate(by_term, timeout);
+
+    std::cout << "\n" << name << "\n    " << by_tree.to_string() << "[" << (timeout - tree_left) << "]";
+    std::cout << "\n    " << store.to_string(by_term) << "[" << (timeout - term_left) << "]";
+    if(!store.compare(store.from_component(by_tree), by_term) || tree_left != term_left) {
+        std::cout << "\n    MISMATCH\n";
+        return 1;
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+int main() {
+    component a,b,c,d,e,f,g,h,i,j,k;
+
+    a.lambda(b.id("w"),
+        c.lambda(d.id("s"),
+            e.lambda(f.id("z"),
+                g.expr(h.id("s"),
+                    i.expr(j.expr(k.id("w"),a.id("s")),b.id("z"))))));
+    global.add_value("S", a);
+
+    a.lambda(b.id("s"),
+        c.lambda(d.id("z"),
+            e.id("z")));
+    global.add_value("0", a);
+
+    for(int n = 1; n <= 4; ++n) {
+        a.expr(b.id("S",&prepkg::global),
+            c.id(std::to_string(n - 1),&prepkg::global));
+        a.evaluate(100);
+        global.add_value(std::to_string(n), a);
+    }
+
+    int failed = 0;
+
+    a.expr(b.expr(c.id("4",&prepkg::global),d.id("S",&prepkg::global)),e.id("4",&prepkg::global));
+    failed += check("4S4", a);
+
+    a.lambda(
+        b.id("y"),
+        c.lambda(
+            d.id("x"),
+            e.expr(
+                f.id("y"),
+                g.expr(
+                    h.lambda(
+                        i.id("y"),
+                        j.lambda(
+                            k.id("x"),
+                            component().expr(
+                                component().id("x"),
+                                component().id("y")))),
+                    component().id("x")))));
+    failed += check("capture", a);
+
+    a.expr(
+        b.lambda(c.id("x"), d.expr(e.id("x"), f.id("x"))),
+        g.lambda(h.id("x"), i.expr(j.id("x"), k.id("x"))));
+    failed += check("omega", a, 50);
+
+    a.expr(b.expr(c.id("4",&prepkg::global),d.id("S",&prepkg::global)),e.id("4",&prepkg::global));
+    failed += check("4S4 shared", a, 1000, true);
+
+    term_store shared(true);
+    package * first = global.add_package("first");
+    package * second = global.add_package("second");
+    first->add_value("4", *global.get_value("4"));
+    second->add_value("4", *global.get_value("4"));
+    term_ref from_first = shared.definition(shared.free("4", first));
+    term_ref from_second = shared.definition(shared.free("4", second));
+    size_t before = shared.size();
+    shared.from_component(*global.get_value("4"));
+    std::cout << "\nshared definitions " << (from_first == from_second ? "are" : "are not") << " one node, "
+        << (shared.size() - before) << " nodes added by a third copy\n";
+    if(from_first != from_second || shared.size() != before)
+        ++failed;
+
+    std::cout << "\n" << failed << " mismatches\n";
+    return failed;
+}
@@ -68,6 +68,9 @@ int token_test() {
         case token_type::rparen:
             std::cout << ")";
             break;
+        case token_type::pragma:
+            std::cout << ";! " << tik.info;
+            break;
         case token_type::newline:
             std::cout << "\n";
             break;
@@ -77,6 +80,21 @@ int token_test() {
         }
     }
 
+    //the mapped file gives the same tokens, viewing its text rather than copying it
+    source_text source;
+    if(!source.map("./test/test.lc")) {
+        std::cerr << "could not map file\n";
+        return 0;
+    }
+    size_t mismatches = source.tokens().size() == tok.size() ? 0 : 1;
+    for(size_t i = 0; i < tok.size() && i < source.tokens().size(); ++i) {
+        const compact_token& mapped = source.tokens()[i];
+        if(mapped.tt != tok[i].tt || mapped.info != tok[i].info || mapped.line_num != tok[i].line_num ||
+                mapped.filename() != tok[i].filename || mapped.sym != tok[i].sym)
+            ++mismatches;
+    }
+    std::cout << "\n" << mismatches << " mismatches\n";
+
     return 0;
 }
 
@@ -0,0 +1,29 @@
+#ifndef LAMBDA_THUNK_H
+#define LAMBDA_THUNK_H
+
+namespace lambda {
+
+/**
+ * how far a thunk of a lazy machine has been evaluated
+ **/
+enum class thunk_state {
+    suspended, //not entered yet
+    entered,   //its value is being computed (a blackhole)
+    evaluated  //overwritten with its value
+};
+
+/**
+ * marks `th` as entered before the machine runs its code. returns false if it already was: its value is only
+ * found by first finding its value, which loops without taking a step, so the caller treats it as a timeout
+ **/
+template<class thunk>
+bool enter_thunk(thunk& th) {
+    if(th.state == thunk_state::entered)
+        return false;
+    th.state = thunk_state::entered;
+    return true;
+}
+
+}
+
+#endif
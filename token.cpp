@@ -2,14 +2,44 @@
 #include <stdexcept>
 #include "emit.h"
 #include <stdio.h>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace lambda {
 
 
 
-token get_package(const std::string& check, int line_num, std::string filename) {
+/**the character at `i`, or '\0' past the end of `line`**/
+static char char_at(std::string_view line, size_t i) {
+    return i < line.size() ? line[i] : '\0';
+}
+
+/**
+ * `name` with the characters a package name cannot have left out. that is `name` itself unless it has any,
+ * otherwise a copy kept in `owned`
+ **/
+static std::string_view package_name(std::string_view name, std::deque<std::string>& owned) {
     size_t i = 0;
-    token ret{token_type::none, "", line_num, filename};
+    for(; i < name.size() && is_valid_pkg_char(name[i]); ++i);
+    if(i == name.size())
+        return name;
+    std::string& ret = owned.emplace_back();
+    for(char c : name) {
+        if(is_valid_pkg_char(c))
+            ret += c;
+    }
+    return ret;
+}
+
+static compact_token get_package(std::string_view check, int line_num, symbol file, std::deque<std::string>& owned) {
+    size_t i = 0;
+    compact_token ret{token_type::none, {}, line_num, file};
 
     for(; i < check.size() && is_whitespace(check[i]); ++i);
 
@@ -18,23 +48,24 @@ token get_package(const std::string& check, int line_num, std::string filename)
 
     if(check[i] == ':' && i + 1 < check.size() && check[i + 1] == ':') {
         i += 2;
+        size_t begin = i, end = check.size();
 
         for(bool has_warned = false; i < check.size(); ++i) {
             if(is_whitespace(check[i])) {
+                end = i;
                 ++i;
                 break;
-            } else if(is_valid_pkg_char(check[i])) {
-                ret.info += check[i];
-            } else if(!has_warned){
+            } else if(!is_valid_pkg_char(check[i]) && !has_warned){
                 has_warned = true;
-                emit_error("invalid characters in package name", line_num, filename);
+                emit_error("invalid characters in package name", line_num, symbols.name(file));
             }
         }
+        ret.info = package_name(check.substr(begin, end - begin), owned);
         
         for(bool has_warned = false; i < check.size(); ++i) {
             if(!is_whitespace(check[i]) && !has_warned) {
                 has_warned = true;
-                emit_warning("ignoring extra characters after package name", line_num, filename);
+                emit_warning("ignoring extra characters after package name", line_num, symbols.name(file));
             }
         }
 
@@ -43,34 +74,34 @@ token get_package(const std::string& check, int line_num, std::string filename)
     } else {
         bool proper_end = false;
         bool invalid_char = false;
+        size_t begin = i;
         for(; i < check.size(); ++i) {
             if(check[i] == ';') {
-                return token{token_type::none};
+                return ret;
             } else if(check[i] == ':' && i + 1 < check.size() && check[i + 1] == ':') {
                 proper_end = true;
+                ret.info = package_name(check.substr(begin, i - begin), owned);
                 i += 2;
                 break;
-            } else if (is_valid_pkg_char(check[i])) {
-                ret.info += check[i];
-            } else {
+            } else if (!is_valid_pkg_char(check[i])) {
                 invalid_char = true;
             }
         }
 
         if(proper_end && invalid_char) {
-            emit_error("invalid characters in package name", line_num, filename);
+            emit_error("invalid characters in package name", line_num, symbols.name(file));
         }
         if(proper_end) {
             ret.tt = token_type::package_begin;
         } else {
-            return token{token_type::none};
+            return compact_token{token_type::none};
         }
 
         for(; i < check.size(); ++i) {
             if(check[i] == ';')
                 break;
             if(!is_whitespace(check[i])) {
-                emit_warning("ignoring extra characters after package name", line_num, filename);
+                emit_warning("ignoring extra characters after package name", line_num, symbols.name(file));
                 break;
             }
         }
@@ -79,23 +110,23 @@ token get_package(const std::string& check, int line_num, std::string filename)
     return ret;
 }
 
-token get_include(std::string check, int line_num, std::string filename) {
-    token ret{token_type::file,"",line_num,filename};
+static compact_token get_include(std::string_view check, int line_num, symbol file) {
+    compact_token ret{token_type::file, {}, line_num, file};
     size_t i = 0;
     for(; i < check.size() && is_whitespace(check[i]); ++i);
 
     if(!(i < check.size() && check[i] == '"')) {
-        return token{token_type::none};
+        return compact_token{token_type::none};
     }
     ++i;
 
-    for(; i < check.size() && check[i] != '"'; ++i) {
-        ret.info += check[i];
-    }
+    size_t begin = i;
+    for(; i < check.size() && check[i] != '"'; ++i);
+    ret.info = check.substr(begin, i - begin);
 
     if(!(i < check.size() && check[i] == '"')) {
-        emit_error("no closing '\"' in file name", line_num, filename);
-        return token{token_type::none};
+        emit_error("no closing '\"' in file name", line_num, symbols.name(file));
+        return compact_token{token_type::none};
     }
     ++i;
 
@@ -103,7 +134,7 @@ token get_include(std::string check, int line_num, std::string filename) {
         if(check[i] == ';')
             break;
         if(!is_whitespace(check[i])) {
-            emit_warning("ignoring extra characters after file name", line_num, filename);
+            emit_warning("ignoring extra characters after file name", line_num, symbols.name(file));
             break;
         }
     }
@@ -114,8 +145,30 @@ token get_include(std::string check, int line_num, std::string filename) {
 //╒╪╤╧╘
 //╫╓╙╥╨╬═╠╦╩╔╚╟╞┼─├┬┴└┐╛╜╝╗║╣╕╖╢╡┤│
 
-std::vector<token> tokenize_line(std::string line, int line_num, std::string filename, int& comment) {
-    std::vector<token> out;
+/**
+ * the symbol of an identifier's name. most names are one character, so their symbols are kept here rather than
+ * looked up in `symbols` every time
+ **/
+static symbol intern_name(std::string_view name) {
+    static std::atomic<symbol> single[256]; //the symbol plus one, 0 until it is first asked for
+    if(name.size() != 1)
+        return symbols.intern(std::string(name));
+    std::atomic<symbol>& kept = single[static_cast<unsigned char>(name[0])];
+    symbol sym = kept.load(std::memory_order_relaxed);
+    if(sym == 0) {
+        sym = symbols.intern(std::string(name)) + 1;
+        kept.store(sym, std::memory_order_relaxed);
+    }
+    return sym - 1;
+}
+
+/**
+ * adds the tokens of a line to `out`, their text viewing `line` or, for text that is not in it, a copy kept in
+ * `owned`. `comment` is how many `;::` comments are open, and is updated for the next line
+ **/
+static void tokenize_line(std::string_view line, int line_num, symbol file, int& comment,
+        std::vector<compact_token>& out, std::deque<std::string>& owned) {
+    size_t first = out.size();
 
     size_t i = 0;
     for(; i < line.size() && comment > 0; ++i) {
@@ -131,85 +184,84 @@ std::vector<token> tokenize_line(std::string line, int line_num, std::string fil
     line = line.substr(i);
     i = 0;
 
-    token pkg = get_package(line, line_num, filename);
+    compact_token pkg = get_package(line, line_num, file, owned);
     if(pkg.tt != token_type::none) {
         out.push_back(pkg);
-        return out;
+        return;
     }
 
-    token inc = get_include(line, line_num, filename);
+    compact_token inc = get_include(line, line_num, file);
     if(inc.tt != token_type::none) {
         out.push_back(inc);
-        return out;
+        return;
     }
 
 
     for(; i < line.size(); ++i) {
-        token id;
+        compact_token id;
+        size_t start;
         bool altname;
         switch(line[i]) {
         case 'L':
-            out.push_back(token{token_type::lambda});
+            out.push_back(compact_token{token_type::lambda, {}, line_num, file});
             break;
         case '.':
             if(line.size() > i + 3 &&
                     line[i + 1] == '.' &&
                     line[i + 2] == '.' &&
                     line[i + 3] == '=') {
-                out.push_back(token{token_type::inductive_definition, "", line_num, filename});
+                out.push_back(compact_token{token_type::inductive_definition, {}, line_num, file});
                 i += 3;
             } else {
-                out.push_back(token{token_type::dot, "", line_num, filename});
+                out.push_back(compact_token{token_type::dot, {}, line_num, file});
             }
             break;
         case ':':
-            if(line[i + 1] == '=') {
-                out.push_back(token{token_type::define, "", line_num, filename});
+            if(char_at(line, i + 1) == '=') {
+                out.push_back(compact_token{token_type::define, {}, line_num, file});
                 ++i;
             } else {
-                id = token{token_type::package_scope, "", line_num, filename};
+                id = compact_token{token_type::package_scope, {}, line_num, file};
+                start = i + 1;
                 bool has_warned = false;
                 while(i < line.size() && !is_whitespace(line[i])) {
                     ++i;
-                    if(line[i] == ':') {
+                    if(char_at(line, i) == ':') {
+                        id.info = package_name(line.substr(start, i - start), owned);
                         out.push_back(id);
                         ++i;
                         break;
                     }
-                    else if (is_valid_pkg_char(line[i])) {
-                        id.info += line[i];
-                    } else if (!has_warned) {
-                        emit_warning("ignoring invalid characters in package name", line_num, filename);
+                    else if (!is_valid_pkg_char(char_at(line, i)) && !has_warned) {
+                        emit_warning("ignoring invalid characters in package name", line_num, symbols.name(file));
                         has_warned = true;
                     }
                 }
-                if(i == line.size() && line[i] != ':') {
-                    emit_warning("reached end of file without completing package name", line_num, filename);
+                if(i == line.size() && char_at(line, i) != ':') {
+                    emit_warning("reached end of file without completing package name", line_num, symbols.name(file));
                 }
                 --i;
             }
             break;
         case '=':
-            if(line[i + 1] == '>') {
-                out.push_back(token{token_type::lazy_define, "", line_num, filename});
+            if(char_at(line, i + 1) == '>') {
+                out.push_back(compact_token{token_type::lazy_define, {}, line_num, file});
                 ++i;
             } else {
-                id = {token_type::identifier, "", line_num, filename};
-                id.info += line[i];
+                start = i;
                 ++i;
-                for(; i < line.size() && line[i] == '\'' ; ++i) {
-                    id.info += line[i];
-                }
+                for(; i < line.size() && line[i] == '\'' ; ++i);
+                out.push_back(compact_token{token_type::identifier, line.substr(start, i - start), line_num, file});
                 --i;
-                out.push_back(id);
             }
             break;
         case '#':
-            out.push_back(token{token_type::identifier, "#", line_num, filename});
+            out.push_back(compact_token{token_type::identifier, line.substr(i, 1), line_num, file});
             break;
         case '`':
-            id = {token_type::identifier, "", line_num, filename};
+            id = {token_type::identifier, {}, line_num, file};
             altname = 0;
+            start = i + 1;
             for(i = i + 1; i < line.size() && !is_name_break(line[i]); ++i) {
                 if(line[i] == '\'') {
                     altname = 1;
@@ -218,23 +270,23 @@ std::vector<token> tokenize_line(std::string line, int line_num, std::string fil
                         break;
                     }
                 }
-                id.info += line[i];
             }
+            id.info = line.substr(start, i - start);
             --i;
             if(id.info.size() == 0) {
-                emit_warning("ignoring zero length name", line_num, filename);
+                emit_warning("ignoring zero length name", line_num, symbols.name(file));
             } else {
                 if(id.info[0] == '\'') {
-                    emit_warning("'\\'' without base name", line_num, filename);
+                    emit_warning("'\\'' without base name", line_num, symbols.name(file));
                 }
                 out.push_back(id);
             }
             break;
         case '(':
-            out.push_back(token{token_type::lparen, "", line_num, filename});
+            out.push_back(compact_token{token_type::lparen, {}, line_num, file});
             break;
         case ')':
-            out.push_back(token{token_type::rparen, "", line_num, filename});
+            out.push_back(compact_token{token_type::rparen, {}, line_num, file});
             break;
         case ';':
             if(line.size() > i + 2 &&
@@ -252,24 +304,61 @@ std::vector<token> tokenize_line(std::string line, int line_num, std::string fil
                     }
                 }
             } else {
+                //";!" starts a comment that is a setting for the statement it is on or the next one
+                if(i + 1 < line.size() && line[i + 1] == '!') {
+                    size_t begin = line.find_first_not_of(" \t\r", i + 2);
+                    size_t end = line.find_last_not_of(" \t\r");
+                    out.push_back(compact_token{token_type::pragma,
+                        begin == std::string_view::npos ? std::string_view() : line.substr(begin, end + 1 - begin),
+                        line_num, file});
+                }
                 i = line.size();
             }
             break;
         default:
             if(!is_whitespace(line[i])) {
-                id = {token_type::identifier, "", line_num, filename};
-                id.info += line[i];
+                start = i;
                 ++i;
-                for(; i < line.size() && line[i] == '\'' ; ++i) {
-                    id.info += line[i];
-                }
+                for(; i < line.size() && line[i] == '\'' ; ++i);
+                out.push_back(compact_token{token_type::identifier, line.substr(start, i - start), line_num, file});
                 --i;
-                out.push_back(id);
             }
             break;
         }
     }
-    out.push_back(token{token_type::newline, "", line_num, filename});
+    out.push_back(compact_token{token_type::newline, {}, line_num, file});
+    for(std::vector<compact_token>::iterator t = out.begin() + first; t != out.end(); ++t) {
+        if(t->tt == token_type::identifier)
+            t->sym = intern_name(t->info);
+    }
+}
+
+/**tokenizes `text` line by line as `getline` splits it, adding the tokens to `out`**/
+static void tokenize_text(std::string_view text, symbol file, std::vector<compact_token>& out,
+        std::deque<std::string>& owned) {
+    int comment = 0;
+    int line_num = 0;
+    for(size_t at = 0; at < text.size();) {
+        const char * end = static_cast<const char*>(std::memchr(text.data() + at, '\n', text.size() - at));
+        size_t length = end == nullptr ? text.size() - at : end - (text.data() + at);
+        tokenize_line(text.substr(at, length), ++line_num, file, comment, out, owned);
+        at += length + 1;
+    }
+}
+
+/**a copy of `tik` that owns its text**/
+static token owned_token(const compact_token& tik, const std::string& filename) {
+    return token{tik.tt, std::string(tik.info), tik.line_num, filename, tik.sym};
+}
+
+std::vector<token> tokenize_line(std::string line, int line_num, std::string filename, int& comment) {
+    std::vector<compact_token> line_tok;
+    std::deque<std::string> owned;
+    tokenize_line(line, line_num, symbols.intern(filename), comment, line_tok, owned);
+    std::vector<token> out;
+    out.reserve(line_tok.size());
+    for(const compact_token& tik : line_tok)
+        out.push_back(owned_token(tik, filename));
     return out;
 }
 
@@ -278,18 +367,66 @@ std::vector<token> tokenize(std::istream& in, std::string filename) {
 
     int comment = 0;
     int line_num = 0;
+    symbol file = symbols.intern(filename);
 
     std::string line;
+    std::vector<compact_token> line_tok;
+    std::deque<std::string> owned;
 
     while(std::getline(in, line)) {
         ++line_num;
-        std::vector<token> line_tok = tokenize_line(line, line_num, filename, comment);
-        out.insert(out.end(), line_tok.begin(), line_tok.end());
+        line_tok.clear();
+        tokenize_line(line, line_num, file, comment, line_tok, owned);
+        for(const compact_token& tik : line_tok)
+            out.push_back(owned_token(tik, filename));
     }
 
     return out;
 }
 
+source_text::~source_text() {
+    if(mapping != nullptr)
+        munmap(mapping, mapped);
+}
 
+bool source_text::map(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    //empty files, and files like pipes that cannot be mapped, are read instead
+    if(S_ISREG(info.st_mode) && info.st_size > 0) {
+        mapped = info.st_size;
+        mapping = mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED)
+            mapping = nullptr;
+    }
+    close(fd);
+    if(mapping != nullptr) {
+        madvise(mapping, mapped, MADV_SEQUENTIAL);
+        tokenize_text(std::string_view(static_cast<const char*>(mapping), mapped), symbols.intern(filename),
+            _tokens, owned);
+        return true;
+    }
+
+    std::ifstream ifs(filename, std::ifstream::binary);
+    if(!ifs.is_open())
+        return false;
+    std::ostringstream text;
+    text << ifs.rdbuf();
+    assign(text.str(), filename);
+    return true;
+}
 
-}
\ No newline at end of file
+void source_text::assign(std::string text, const std::string& filename) {
+    std::string& kept = owned.emplace_back(std::move(text));
+    tokenize_text(kept, symbols.intern(filename), _tokens, owned);
+}
+
+
+
+}
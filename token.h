@@ -1,8 +1,11 @@
 #ifndef LAMBDA_TOKEN_H
 #define LAMBDA_TOKEN_H
 
+#include <deque>
 #include <vector>
 #include <iostream>
+#include <string_view>
+#include "symbol.h"
 
 namespace lambda {
 
@@ -22,6 +25,7 @@ enum class token_type {
     package_scope,
     lparen,
     rparen,
+    pragma,
     newline,
     none
 };
@@ -34,6 +38,49 @@ struct token {
     std::string info;
     int line_num;
     std::string filename;
+    /**`info` interned, for identifiers**/
+    symbol sym = no_symbol;
+};
+
+/**
+ * a token as a view of the text it was read from, for tokenizing without copying. `info` is a span of the
+ * file, except for package names with invalid characters, which view a copy with them left out. `file` is
+ * the file's name interned in `symbols`
+ **/
+struct compact_token {
+    token_type tt;
+    std::string_view info;
+    int line_num;
+    symbol file;
+    /**`info` interned, for identifiers**/
+    symbol sym = no_symbol;
+
+    const std::string& filename() const { return symbols.name(file); }
+};
+
+/**
+ * a file memory-mapped and tokenized into compact tokens, which view its text and so only last as long as
+ * this does. files that cannot be mapped are read into memory instead
+ **/
+class source_text {
+private:
+    void * mapping = nullptr;
+    size_t mapped = 0;
+    /**text that is not in the mapping: all of it if the file was read, and rewritten package names**/
+    std::deque<std::string> owned;
+    std::vector<compact_token> _tokens;
+public:
+    source_text() {}
+    source_text(const source_text&) = delete;
+    ~source_text();
+
+    /**maps and tokenizes the file `filename`, returning false if it could not be opened**/
+    bool map(const std::string& filename);
+    /**tokenizes `text` as if it were the file `filename`**/
+    void assign(std::string text, const std::string& filename);
+
+    std::vector<compact_token>& tokens() { return _tokens; }
+    const std::vector<compact_token>& tokens() const { return _tokens; }
 };
 
 /**
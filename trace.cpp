@@ -0,0 +1,194 @@
+#include "trace.h"
+#include <cstring>
+#include <sstream>
+
+namespace lambda {
+
+/**buffered output is written out once it passes this many bytes**/
+static const size_t flush_at = 1 << 16;
+
+text_trace::text_trace(std::ostream& out, bool steps) : out(out), steps(steps) {
+    buffer.reserve(flush_at);
+}
+
+text_trace::~text_trace() {
+    flush();
+}
+
+void text_trace::reserve() {
+    if(buffer.size() >= flush_at)
+        flush();
+}
+
+void text_trace::echo(std::string_view text) {
+    buffer += text;
+    reserve();
+}
+
+void text_trace::step(const component& term) {
+    buffer += "\n     ";
+    term.write(buffer);
+    reserve();
+}
+
+void text_trace::result(const component& term, int steps, const reduction_stats * stats, double ms) {
+    buffer += "\n    ";
+    term.write(buffer);
+    buffer += "[" + std::to_string(steps) + "]";
+    if(stats != nullptr) {
+        buffer += "{beta " + std::to_string(stats->beta) + ", delta " + std::to_string(stats->delta) +
+            ", updates " + std::to_string(stats->updates) + "}";
+    }
+    if(ms >= 0) {
+        //formatted by a stream, as it always was
+        std::ostringstream time;
+        time << "(" << ms << "ms)";
+        buffer += time.str();
+    }
+    buffer += "\n";
+    //written out per statement so that it stays in order with warnings, which go straight to std::cerr
+    flush();
+}
+
+void text_trace::flush() {
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+json_trace::json_trace(std::ostream& out) : out(out) {
+    buffer.reserve(flush_at);
+}
+
+json_trace::json_trace(const std::string& filename) : file(filename), out(file) {
+    buffer.reserve(flush_at);
+}
+
+json_trace::~json_trace() {
+    flush();
+}
+
+void json_trace::reserve() {
+    if(buffer.size() >= flush_at)
+        flush();
+}
+
+void json_trace::statement(const component&, int line, const std::string& file) {
+    this->line = line;
+    filename.clear();
+    for(char c : file) {
+        if(c == '"' || c == '\\')
+            filename += '\\';
+        filename += c;
+    }
+}
+
+void json_trace::work(const work_counters& done) {
+    this->done = done;
+}
+
+void json_trace::result(const component&, int steps, const reduction_stats * stats, double ms) {
+    buffer += "{\"file\":\"" + filename + "\",\"line\":" + std::to_string(line) +
+        ",\"steps\":" + std::to_string(steps) + ",\"ms\":";
+    if(ms >= 0) {
+        std::ostringstream time;
+        time << ms;
+        buffer += time.str();
+    } else {
+        buffer += "null";
+    }
+    buffer += ",\"beta\":" + std::to_string(stats != nullptr ? stats->beta : done.beta) +
+        ",\"delta\":" + std::to_string(stats != nullptr ? stats->delta : done.delta);
+    if(stats != nullptr)
+        buffer += ",\"updates\":" + std::to_string(stats->updates);
+    buffer += ",\"renames\":" + std::to_string(done.renames) + ",\"allocated\":" + std::to_string(done.allocated) +
+        ",\"freed\":" + std::to_string(done.freed) + ",\"copied_bytes\":" + std::to_string(done.copied_bytes) +
+        ",\"peak_live\":" + std::to_string(done.peak) + "}\n";
+    done = work_counters();
+    reserve();
+}
+
+void json_trace::flush() {
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+binary_trace::binary_trace(const std::string& filename) : out(filename, std::ofstream::binary) {
+    buffer.reserve(flush_at);
+    buffer.append(trace_magic, sizeof(trace_magic));
+    put(trace_version);
+}
+
+binary_trace::~binary_trace() {
+    flush();
+}
+
+void binary_trace::put(uint32_t value) {
+    for(int i = 0; i < 4; ++i)
+        put(uint8_t(value >> (8 * i)));
+}
+
+void binary_trace::put(uint64_t value) {
+    for(int i = 0; i < 8; ++i)
+        put(uint8_t(value >> (8 * i)));
+}
+
+void binary_trace::put(const std::string& s) {
+    put(uint32_t(s.size()));
+    buffer += s;
+}
+
+void binary_trace::reserve() {
+    if(buffer.size() >= flush_at)
+        flush();
+}
+
+void binary_trace::statement(const component& term, int line, const std::string& file) {
+    put(uint8_t(trace_statement));
+    put(uint32_t(line));
+    put(file);
+    put(uint32_t(term.size()));
+    reserve();
+}
+
+void binary_trace::step(const component& term) {
+    put(uint8_t(trace_step));
+    put(uint32_t(term.size()));
+    reserve();
+}
+
+void binary_trace::result(const component& term, int steps, const reduction_stats * stats, double ms) {
+    put(uint8_t(trace_result));
+    put(uint32_t(steps));
+    put(uint64_t(stats != nullptr ? stats->beta : -1));
+    put(uint64_t(stats != nullptr ? stats->delta : -1));
+    put(uint64_t(stats != nullptr ? stats->updates : -1));
+    uint64_t bits;
+    std::memcpy(&bits, &ms, sizeof(bits));
+    put(bits);
+    put(term.to_string());
+    reserve();
+}
+
+void binary_trace::definition(const std::string& name, const component& value) {
+    put(uint8_t(trace_definition));
+    put(name);
+    put(uint32_t(value.size()));
+    reserve();
+}
+
+void binary_trace::timeout(int line, const std::string& file) {
+    put(uint8_t(trace_timeout));
+    put(uint32_t(line));
+    put(file);
+    reserve();
+}
+
+void binary_trace::flush() {
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+}
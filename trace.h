@@ -0,0 +1,150 @@
+#ifndef LAMBDA_TRACE_H
+#define LAMBDA_TRACE_H
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "component.h"
+#include "engine.h"
+
+namespace lambda {
+
+/**
+ * receives what load_file and component::evaluate report while a program runs.
+ *
+ * every event does nothing by default, so this class is itself the null sink. evaluate() only calls step(),
+ * and so only builds anything for a step, when wants_steps() is true
+ **/
+class trace_sink {
+public:
+    virtual ~trace_sink() {}
+
+    /**text of the statement being read, in pieces as its tokens are parsed**/
+    virtual void echo(std::string_view /*text*/) {}
+    /**a complete statement about to be evaluated**/
+    virtual void statement(const component& /*term*/, int /*line*/, const std::string& /*file*/) {}
+    virtual bool wants_steps() const { return false; }
+    /**the term before each step of component::evaluate**/
+    virtual void step(const component& /*term*/) {}
+    /**
+     * the value of a statement and the steps it took. `stats` is null for engines that do not count their work
+     * by kind, and `ms` is negative if the statement was not timed
+     **/
+    virtual void result(const component& /*term*/, int /*steps*/, const reduction_stats * /*stats*/, double /*ms*/) {}
+    /**the work counted on this thread while a statement was evaluated, given just before its result**/
+    virtual void work(const work_counters& /*done*/) {}
+    virtual void definition(const std::string& /*name*/, const component& /*value*/) {}
+    /**a statement that ran out of steps**/
+    virtual void timeout(int /*line*/, const std::string& /*file*/) {}
+    virtual void flush() {}
+};
+
+/**
+ * writes the same text the interpreter has always printed, collected in a buffer that is written out after each
+ * statement's result, whenever it gets large, and on flush()
+ **/
+class text_trace : public trace_sink {
+private:
+    std::ostream& out;
+    std::string buffer;
+    bool steps;
+
+    void reserve();
+public:
+    /**`steps` prints every step of the rewrite engine**/
+    explicit text_trace(std::ostream& out, bool steps = true);
+    ~text_trace();
+
+    void echo(std::string_view text) override;
+    bool wants_steps() const override { return steps; }
+    void step(const component& term) override;
+    void result(const component& term, int steps, const reduction_stats * stats, double ms) override;
+    void flush() override;
+};
+
+/**
+ * records events in a compact binary form: after the header, each event is a byte of trace_event followed by
+ * its fields, integers little endian and strings as a uint32_t length and their characters.
+ *
+ *   statement   uint32_t line, string file, uint32_t nodes
+ *   step        uint32_t nodes
+ *   result      int32_t steps, int64_t beta, delta, updates (-1 if not counted), double ms, string term
+ *   definition  string name, uint32_t nodes
+ *   timeout     uint32_t line, string file
+ *
+ * steps only record the size of the term, so tracing them builds no strings
+ **/
+class binary_trace : public trace_sink {
+private:
+    std::ofstream out;
+    std::string buffer;
+
+    void put(uint8_t byte) { buffer += char(byte); }
+    void put(uint32_t value);
+    void put(uint64_t value);
+    void put(const std::string& s);
+    void reserve();
+public:
+    explicit binary_trace(const std::string& filename);
+    ~binary_trace();
+    bool is_open() const { return out.is_open(); }
+
+    void statement(const component& term, int line, const std::string& file) override;
+    bool wants_steps() const override { return true; }
+    void step(const component& term) override;
+    void result(const component& term, int steps, const reduction_stats * stats, double ms) override;
+    void definition(const std::string& name, const component& value) override;
+    void timeout(int line, const std::string& file) override;
+    void flush() override;
+};
+
+/**
+ * writes a line of JSON for every statement with the steps it took and the work counted while it was
+ * evaluated:
+ *
+ *   {"file":"f.lc","line":3,"steps":12,"ms":0.5,"beta":10,"delta":2,"renames":0,"allocated":140,
+ *    "freed":131,"copied_bytes":5280,"peak_live":40}
+ *
+ * `ms` is null unless statements are timed. for engines that count their own work, beta and delta are theirs
+ * and "updates" is added; the other counts only cover work done on components, on the thread that ran
+ * load_file. `peak_live` is the most components live at once, beyond those live when the statement started
+ **/
+class json_trace : public trace_sink {
+private:
+    std::ofstream file;
+    std::ostream& out;
+    std::string buffer;
+    std::string filename;
+    int line = 0;
+    work_counters done;
+
+    void reserve();
+public:
+    explicit json_trace(std::ostream& out);
+    /**writes to the file `filename` instead, see is_open()**/
+    explicit json_trace(const std::string& filename);
+    ~json_trace();
+    bool is_open() const { return &out != &file || file.is_open(); }
+
+    void statement(const component& term, int line, const std::string& file) override;
+    void result(const component& term, int steps, const reduction_stats * stats, double ms) override;
+    void work(const work_counters& done) override;
+    void flush() override;
+};
+
+enum trace_event : uint8_t {
+    trace_statement = 1,
+    trace_step = 2,
+    trace_result = 3,
+    trace_definition = 4,
+    trace_timeout = 5
+};
+
+const char trace_magic[8] = {'L', 'C', 'T', 'R', 'A', 'C', 'E', '\0'};
+const uint32_t trace_version = 1;
+
+}
+
+#endif